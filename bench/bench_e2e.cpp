@@ -0,0 +1,307 @@
+// End-to-end latency benchmark: builds synthetic indexes, then runs dv-binary --tab/--enter as a
+// fresh process many times and reports latency percentiles per phase.
+//
+//   bench_e2e [--runs N] [--sizes 10000,100000,1000000] [--binary PATH]
+//
+// Phases come from the timestamps dv-binary prints when DIRVANA_TIMINGS is set:
+//   start   spawn until main() is entered (exec, dynamic loading, static initializers)
+//   config  Config load
+//   open    Database open
+//   query   Handler::handle_call (query and formatting)
+//   output  final flush of stdout
+//   total   spawn until the process has been reaped
+//
+// --enter is a mutating workload: every run records the visit, which reranks the path and moves the index to a new
+// generation, so its samples include those writes and later runs see the ranks earlier ones left behind.
+
+#include "Database.h"
+#include "Helpers.h"
+
+#include <json.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <unordered_set>
+
+#include <poll.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+#ifndef DV_BINARY_PATH
+#define DV_BINARY_PATH "dv-binary"
+#endif
+
+using json = nlohmann::json;
+
+static const std::vector<std::string> WORDS = {
+	"src", "lib", "app", "api", "web", "core", "utils", "tests", "docs", "build", "scripts", "config",
+	"services", "models", "views", "components", "assets", "public", "internal", "cmd", "pkg", "tools",
+	"frontend", "backend", "server", "client", "shared", "common", "infra", "deploy", "terraform", "k8s",
+	"migrations", "schemas", "handlers", "routes", "auth", "billing", "payments", "search", "analytics",
+	"notifications", "dashboard", "admin", "mobile", "ios", "android", "platform", "data", "pipeline",
+	"ingest", "export", "reports", "fixtures", "examples", "benchmarks", "vendor", "third_party", "proto",
+	"generated", "release", "staging", "production", "sandbox", "experiments", "notebooks", "design",
+};
+
+// `dv build` and friends run a subcommand (a rebuild, say) instead of a query, so no partial may spell one
+static const std::unordered_set<std::string> SUBCOMMANDS = {
+	"build", "rebuild", "refresh", "install", "init", "add", "delete", "list", "show"
+};
+
+static const std::vector<std::string> PHASES = { "start", "config", "open", "query", "output", "total" };
+
+
+// Builds a random tree of `count` directories under `root`, biased towards shallow, wide projects
+static std::vector<std::tuple<std::string, std::string>> synthetic_rows(const std::string& root, size_t count, std::mt19937& rng) {
+	std::vector<std::tuple<std::string, std::string>> rows;
+	std::unordered_set<std::string> seen;
+	std::vector<std::string> parents = { root };
+	rows.reserve(count);
+
+	std::uniform_int_distribution<size_t> word(0, WORDS.size() - 1);
+	while (rows.size() < count) {
+		// Favour recently created parents so the tree grows deep as well as wide
+		std::uniform_int_distribution<size_t> parent(parents.size() > 64 ? parents.size() - 64 : 0, parents.size() - 1);
+		const std::string& base = rng() % 4 == 0 ? parents[rng() % parents.size()] : parents[parent(rng)];
+
+		std::string name = WORDS[word(rng)];
+		if (rng() % 3 == 0)
+			name += "-" + WORDS[word(rng)];
+		if (rng() % 5 == 0)
+			name += std::to_string(rng() % 100);
+
+		std::string path = base + "/" + name;
+		if (not seen.insert(path).second)
+			continue;
+		rows.push_back({ path, name });
+		parents.push_back(path);
+	}
+	return rows;
+}
+
+// Realistic partials: short prefixes of directory names that exist, with the odd typo-free full name
+static std::vector<std::string> synthetic_partials(const std::vector<std::tuple<std::string, std::string>>& rows, size_t count, std::mt19937& rng) {
+	std::vector<std::string> partials;
+	while (partials.size() < count) {
+		const std::string& name = std::get<1>(rows[rng() % rows.size()]);
+		size_t length = rng() % 4 == 0 ? name.size() : std::min(name.size(), static_cast<size_t>(2 + rng() % 4));
+		std::string partial = name.substr(0, length);
+		if (not SUBCOMMANDS.contains(partial))
+			partials.push_back(std::move(partial));
+	}
+	return partials;
+}
+
+
+// Turns `home` into a HOME whose default config.json points at an index built from `rows`
+static void prepare_home(const std::filesystem::path& home, const std::vector<std::tuple<std::string, std::string>>& rows) {
+	std::filesystem::path config_path = home / "Library/Application Support/dirvana/config.json";
+	std::filesystem::create_directories(config_path.parent_path());
+
+	json config = Config(config_path.string()).get_config();
+	config["paths"]["db"] = (home / "dirvana.db").string();
+	config["paths"]["init"] = (home / "root").string();
+	std::ofstream(config_path) << config.dump(4);
+
+	Config loaded(config_path.string());
+	Database db(loaded);
+	db.get_paths_table().bulk_insert(rows);
+}
+
+
+struct Sample {
+	bool ok = false;
+	long long phases[6] = {};
+};
+
+static void drain(int fd, std::string& out) {
+	char buffer[4096];
+	ssize_t n = read(fd, buffer, sizeof(buffer));
+	if (n > 0)
+		out.append(buffer, n);
+}
+
+// Spawns dv-binary once and splits its latency into phases
+static Sample run_once(const std::string& binary, const std::vector<std::string>& args, char** envp) {
+	std::vector<char*> argv = { const_cast<char*>(binary.c_str()) };
+	for (const auto& arg : args)
+		argv.push_back(const_cast<char*>(arg.c_str()));
+	argv.push_back(nullptr);
+
+	int out_pipe[2], err_pipe[2];
+	if (pipe(out_pipe) != 0 or pipe(err_pipe) != 0)
+		return {};
+
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_adddup2(&actions, out_pipe[1], STDOUT_FILENO);
+	posix_spawn_file_actions_adddup2(&actions, err_pipe[1], STDERR_FILENO);
+	posix_spawn_file_actions_addclose(&actions, out_pipe[0]);
+	posix_spawn_file_actions_addclose(&actions, err_pipe[0]);
+
+	pid_t pid;
+	long long spawned = Time::monotonic_ns();
+	int spawn_error = posix_spawn(&pid, binary.c_str(), &actions, nullptr, argv.data(), envp);
+	posix_spawn_file_actions_destroy(&actions);
+	close(out_pipe[1]);
+	close(err_pipe[1]);
+	if (spawn_error != 0) {
+		close(out_pipe[0]);
+		close(err_pipe[0]);
+		return {};
+	}
+
+	// Read both pipes until the child closes them so neither can fill up and stall it
+	std::string out, err;
+	struct pollfd fds[2] = { { out_pipe[0], POLLIN, 0 }, { err_pipe[0], POLLIN, 0 } };
+	int open_fds = 2;
+	while (open_fds > 0 and poll(fds, 2, -1) > 0) {
+		for (int i = 0; i < 2; i++) {
+			if (fds[i].fd < 0 or fds[i].revents == 0)
+				continue;
+			size_t before = i == 0 ? out.size() : err.size();
+			drain(fds[i].fd, i == 0 ? out : err);
+			if ((i == 0 ? out.size() : err.size()) == before) {
+				close(fds[i].fd);
+				fds[i].fd = -1;
+				open_fds--;
+			}
+		}
+	}
+	int status = 0;
+	waitpid(pid, &status, 0);
+	long long reaped = Time::monotonic_ns();
+
+	Sample sample;
+	size_t line = err.find("dirvana-timings ");
+	if (line == std::string::npos or not WIFEXITED(status))
+		return sample;
+
+	long long marks[5];
+	std::istringstream timings(err.substr(line + std::strlen("dirvana-timings ")));
+	for (long long& mark : marks)
+		timings >> mark;
+	if (not timings)
+		return sample;
+
+	sample.ok = true;
+	sample.phases[0] = marks[0] - spawned;
+	for (int i = 1; i < 5; i++)
+		sample.phases[i] = marks[i] - marks[i - 1];
+	sample.phases[5] = reaped - spawned;
+	return sample;
+}
+
+
+static long long percentile(std::vector<long long>& values, double p) {
+	if (values.empty())
+		return 0;
+	std::sort(values.begin(), values.end());
+	size_t rank = static_cast<size_t>(p * values.size() + 0.999999);
+	return values[std::clamp<size_t>(rank, 1, values.size()) - 1];
+}
+
+static void report(const std::string& title, const std::vector<Sample>& samples) {
+	std::vector<long long> columns[6];
+	size_t failed = 0;
+	for (const auto& sample : samples) {
+		if (not sample.ok) {
+			failed++;
+			continue;
+		}
+		for (int i = 0; i < 6; i++)
+			columns[i].push_back(sample.phases[i]);
+	}
+
+	std::cout << "\n" << title << " (" << samples.size() - failed << " runs";
+	if (failed > 0)
+		std::cout << ", " << failed << " failed";
+	std::cout << ", microseconds)\n";
+	std::cout << std::left << std::setw(8) << "phase" << std::right;
+	for (const char* header : { "p50", "p90", "p99", "max" })
+		std::cout << std::setw(10) << header;
+	std::cout << "\n";
+
+	for (int i = 0; i < 6; i++) {
+		std::cout << std::left << std::setw(8) << PHASES[i] << std::right << std::fixed << std::setprecision(1);
+		for (double p : { 0.50, 0.90, 0.99, 1.0 })
+			std::cout << std::setw(10) << percentile(columns[i], p) / 1000.0;
+		std::cout << "\n";
+	}
+	std::cout.flush();
+}
+
+
+int main(int argc, char* argv[]) {
+	size_t runs = 2000;
+	std::vector<size_t> sizes = { 10000, 100000, 1000000 };
+	std::string binary = DV_BINARY_PATH;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--runs" and i + 1 < argc)
+			runs = std::stoul(argv[++i]);
+		else if (arg == "--binary" and i + 1 < argc)
+			binary = argv[++i];
+		else if (arg == "--sizes" and i + 1 < argc) {
+			sizes.clear();
+			std::istringstream list(argv[++i]);
+			for (std::string size; std::getline(list, size, ',');)
+				sizes.push_back(std::stoul(size));
+		} else {
+			std::cerr << "Usage: " << argv[0] << " [--runs N] [--sizes 10000,100000,1000000] [--binary PATH]" << std::endl;
+			return 1;
+		}
+	}
+
+	std::filesystem::path work_dir = std::filesystem::temp_directory_path() / ("dirvana_bench_" + std::to_string(getpid()));
+	std::filesystem::create_directories(work_dir);
+	std::mt19937 rng(42);
+
+	for (size_t size : sizes) {
+		std::cout << "Building index of " << size << " directories..." << std::flush;
+		std::string home = (work_dir / ("home_" + std::to_string(size))).string();
+		auto rows = synthetic_rows(home + "/root", size, rng);
+		prepare_home(home, rows);
+		std::vector<std::string> partials = synthetic_partials(rows, runs, rng);
+		std::cout << " done" << std::endl;
+
+		// The child gets its own HOME, and a runtime dir without a daemon socket so every run is in-process. Repeated
+		// partials would otherwise be answered from the query cache, so every run plans and runs its query.
+		std::vector<std::string> env_storage = { "HOME=" + home, "XDG_RUNTIME_DIR=" + home, "DIRVANA_TIMINGS=1", "DIRVANA_NO_QUERY_CACHE=1" };
+		for (char** var = environ; *var != nullptr; var++) {
+			std::string_view entry = *var;
+			if (not entry.starts_with("HOME=") and not entry.starts_with("XDG_RUNTIME_DIR=") and not entry.starts_with("DIRVANA_TIMINGS=") and
+				not entry.starts_with("DIRVANA_NO_QUERY_CACHE="))
+				env_storage.push_back(*var);
+		}
+		std::vector<char*> envp;
+		for (auto& var : env_storage)
+			envp.push_back(var.data());
+		envp.push_back(nullptr);
+
+		for (const char* mode : { "--tab", "--enter" }) {
+			// Warm the page cache and the config snapshot before measuring
+			for (size_t i = 0; i < std::min<size_t>(runs, 20); i++)
+				run_once(binary, { mode, "dv", partials[i] }, envp.data());
+
+			std::vector<Sample> samples;
+			samples.reserve(runs);
+			for (const auto& partial : partials)
+				samples.push_back(run_once(binary, { mode, "dv", partial }, envp.data()));
+			report(std::to_string(size) + " directories, dv-binary " + mode, samples);
+		}
+	}
+
+	std::filesystem::remove_all(work_dir);
+	return 0;
+}
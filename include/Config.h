@@ -6,71 +6,100 @@
 
 #include <json.hpp>
 
+#include <climits>
+#include <optional>
+#include <cstdint>
+
 using json = nlohmann::json;
 
 
+// Flat, pre-validated view of config.json. It is written next to the config file as a binary cache
+// keyed on the source's mtime and size, so a normal startup reads it back without parsing any JSON.
+struct ConfigSnapshot {
+	static constexpr uint32_t MAGIC = 0x44564346; // "DVCF"
+	static constexpr uint32_t FORMAT = 1;
+
+	uint32_t magic = MAGIC;
+	uint32_t format = FORMAT;
+	int64_t source_mtime = 0;
+	uint64_t source_size = 0;
+
+	int32_t max_results = 10;
+	int32_t max_history_size = 100;
+	MatchingType matching_type = MatchingType::Contains;
+	PromotionStrategy promotion_strategy = PromotionStrategy::RECENTLY_ACCESSED;
+
+	char init_path[PATH_MAX] = {};
+	char db_path[PATH_MAX] = {};
+	char history_path[PATH_MAX] = {};
+};
+
+
 // Config class loads, validates, and provides access to the configuration data
 class Config {
 public:
 	Config(const std::string& config_path = "");
 
 	// Getters for the configuration data
-	const json& get_config() const { return config; }
-	std::string get_init_path() const { return config["paths"]["init"].get<std::string>(); }
-	std::string get_db_path() const { return config["paths"]["db"].get<std::string>(); }
-	std::string get_history_path() const { return config["paths"]["history"].get<std::string>(); }
-	int get_max_results() const { return config["matching"]["max_results"].get<int>(); }
-	int get_max_history_size() const { return config["matching"]["max_history_size"].get<int>(); }
-	MatchingType get_matching_type() const { return TypeConversions::s_to_matching_type(config["matching"]["type"].get<std::string>()); }
-	PromotionStrategy get_promotion_strategy() const {
-		return TypeConversions::s_to_promotion_strategy(config["matching"]["promotion_strategy"].get<std::string>());
-	}
-	const std::vector<ExclusionRule> get_exclusion_rules() const { 
-		return generate_exclusion_rules(config["matching"]["exclusions"]); 
-	}
+	const json& get_config() const { return load_json(); }
+	const std::string& get_config_path() const { return config_path; }
+	std::string get_init_path() const { return snapshot.init_path; }
+	std::string get_db_path() const { return snapshot.db_path; }
+	std::string get_history_path() const { return snapshot.history_path; }
+	int get_max_results() const { return snapshot.max_results; }
+	int get_max_history_size() const { return snapshot.max_history_size; }
+	MatchingType get_matching_type() const { return snapshot.matching_type; }
+	PromotionStrategy get_promotion_strategy() const { return snapshot.promotion_strategy; }
+	// Exclusion rules are only needed when scanning, so they are generated from the JSON on first use
+	const std::vector<ExclusionRule>& get_exclusion_rules() const;
 
 	// Setters for the configuration data
-	void set_config(const json& user_config) { config = user_config; }
-	void set_init_path(const std::string& init_path) { config["paths"]["init"] = init_path; }
-	void set_db_path(const std::string& db_path) { config["paths"]["db"] = db_path; }
-	void set_history_path(const std::string& history_path) { config["paths"]["history"] = history_path; }
-	void set_max_results(int max_results) { config["matching"]["max_results"] = max_results; }
-	void set_max_history_size(int max_history_size) { config["matching"]["max_history_size"] = max_history_size; }
-	void set_matching_type(const std::string& matching_type) { config["matching"]["type"] = matching_type; }
+	void set_config(const json& user_config) { config = user_config; json_loaded = true; exclusion_rules.reset(); compile(config); }
+	void set_init_path(const std::string& init_path) { load_json()["paths"]["init"] = init_path; copy_path(snapshot.init_path, init_path); }
+	void set_db_path(const std::string& db_path) { load_json()["paths"]["db"] = db_path; copy_path(snapshot.db_path, db_path); }
+	void set_history_path(const std::string& history_path) {
+		load_json()["paths"]["history"] = history_path;
+		copy_path(snapshot.history_path, history_path);
+	}
+	void set_max_results(int max_results) { load_json()["matching"]["max_results"] = max_results; snapshot.max_results = max_results; }
+	void set_max_history_size(int max_history_size) {
+		load_json()["matching"]["max_history_size"] = max_history_size;
+		snapshot.max_history_size = max_history_size;
+	}
+	void set_matching_type(const std::string& matching_type) {
+		load_json()["matching"]["type"] = matching_type;
+		snapshot.matching_type = TypeConversions::s_to_matching_type(matching_type);
+	}
 	void set_promotion_strategy(const std::string& promotion_strategy) {
-		config["matching"]["promotion_strategy"] = promotion_strategy;
+		load_json()["matching"]["promotion_strategy"] = promotion_strategy;
+		snapshot.promotion_strategy = TypeConversions::s_to_promotion_strategy(promotion_strategy);
 	}
 	void set_exclusion_rules(const std::vector<ExclusionRule>& exclusion_rules) {
-		config["matching"]["exclusions"] = TypeConversions::exclusion_rules_to_json(exclusion_rules);
+		load_json()["matching"]["exclusions"] = TypeConversions::exclusion_rules_to_json(exclusion_rules);
+		this->exclusion_rules = exclusion_rules;
 	}
 
-	
+
 private:
-	std::string config_path = (std::getenv("HOME") != nullptr ? std::getenv("HOME") : "")+ std::string("/Library/Application Support/dirvana/config.json");
-	json config;
-	json default_config = {
-		{"paths", {
-			{"init", (std::getenv("HOME") != nullptr ? std::getenv("HOME") : "") + std::string("/")},
-			{"db", (std::getenv("HOME") != nullptr ? std::getenv("HOME") : "") + std::string("/Library/Application Support/dirvana/dirvana.db")}
-		}},
-		{"matching", {
-			{"max_results", 10},
-			{"max_history_size", 100},
-			{"type", "contains"},
-			{"promotion_strategy", "recently_accessed"},
-			{"exclusions", {
-				{"prefix", {"."}},
-				{"exact", {"node_modules", "browser_components", "dist", "out", "target", "tmp", "temp", "cache", "venv", "env", "obj", "pkg", "bin"}},
-				{"suffix", {"sdk", "Library"}},
-				{"contains", {"release"}}
-				}
-			}
-		}}
-	};
-	std::vector<ExclusionRule> exclusion_rules;
+	std::string home;
+	std::string config_path;
+	ConfigSnapshot snapshot;
+
+	// The parsed JSON is only materialized when something needs more than the snapshot
+	mutable json config;
+	mutable bool json_loaded = false;
+	mutable std::optional<std::vector<ExclusionRule>> exclusion_rules;
+
+	json& load_json() const;
+	json default_config() const;
+	std::string cache_path() const { return config_path + ".cache"; }
+	bool load_cache(int64_t mtime, uint64_t size);
+	void save_cache();
+	void compile(const json& user_config);
+	static void copy_path(char (&dest)[PATH_MAX], const std::string& src);
 
 	std::vector<ExclusionRule> generate_exclusion_rules(const json& exclusions) const;
 	bool validate_config(json& user_config) const;
 };
 
-#endif // CONFIG_H
\ No newline at end of file
+#endif // CONFIG_H
@@ -0,0 +1,41 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include "Handler.h"
+#include "RequestGeneration.h"
+
+#include <memory>
+#include <string>
+#include <filesystem>
+
+
+// Long-lived server that keeps the Config, Database and Handler warm and answers
+// --tab/--enter requests over a per-user Unix domain socket
+class Daemon {
+public:
+	Daemon(const std::string& version, const std::string& config_path = "");
+
+	// Runs the accept loop until `dv-binary daemon stop` or SIGINT/SIGTERM
+	int serve();
+
+	// Client side: sends argv to a running daemon and writes its reply to stdout. A completion sends the generation it
+	// claimed along, so the daemon can drop it once a newer one starts on the same terminal.
+	// Returns false (without producing any output) if no daemon answered, so the caller can run in-process.
+	static bool forward(int argc, char* argv[], const std::string& version, int& status,
+		const RequestGeneration* generation = nullptr);
+	static std::string socket_path();
+
+private:
+	std::string version;
+	std::string config_path;
+
+	std::unique_ptr<Config> config;
+	std::unique_ptr<Database> db;
+	std::unique_ptr<Handler> handler;
+	std::filesystem::file_time_type config_mtime;
+
+	void reload_if_stale();
+	bool handle_connection(int client_fd);
+};
+
+#endif // DAEMON_H
@@ -2,32 +2,97 @@
 #define DATABASE_H
 
 #include "Config.h"
+#include "QueryCache.h"
 #include "tables/Paths.h"
 #include "tables/Shortcuts.h"
 
 #include <sqlite_modern_cpp.h>
 
+#include <functional>
+#include <memory>
+#include <unordered_map>
+
 
 class Database {
 public:
+	// Bump whenever a table definition changes so existing databases get migrated on next open
+	static constexpr int SCHEMA_VERSION = 13;
 
-	Database(const Config& config);
+	Database(const Config& config, bool read_only = false);
 	
 	bool build(const std::string& init_path, bool force = false);
 	bool refresh(const std::string& init_path);
 
+	// Makes running statements fail with SQLITE_INTERRUPT once `should_abort` returns true (polled every few thousand VM steps)
+	void set_abort_check(std::function<bool()> should_abort);
+	bool was_aborted() const { return aborted; }
+	// Runs the abort check from code that isn't inside a statement (sticky, like an interrupt)
+	bool poll_abort() { return aborted = aborted or (should_abort and should_abort()); }
+
 	const Config& get_config() const { return config; }
+	bool is_read_only() const { return read_only; }
 	PathsTable& get_paths_table() { return paths_table; }
 	ShortcutsTable& get_shortcuts_table() { return shortcuts_table; }
+	// Opened on first use, in a file next to the index
+	QueryCache& get_query_cache();
 
 	auto operator<<(const std::string& sql) { return db << sql; }
+	// Raw handle for hot paths that step statements themselves instead of going through sqlite_modern_cpp
+	sqlite3* connection() const { return db.connection().get(); }
+
+	// A prepared statement borrowed from the connection's cache. Going out of scope resets it and clears its
+	// bindings (so SQLITE_STATIC binds never outlive their strings) and hands it back for the next caller.
+	class Statement {
+	public:
+		Statement() = default;
+		Statement(Statement&& other) noexcept;
+		Statement& operator=(Statement&& other) noexcept;
+		~Statement();
+
+		sqlite3_stmt* get() const { return stmt; }
+		explicit operator bool() const { return stmt != nullptr; }
+
+	private:
+		friend class Database;
+		sqlite3_stmt* stmt = nullptr;
+		// Cleared on release; null for a statement prepared outside the cache, which is finalized instead
+		bool* in_use = nullptr;
+
+		void release();
+	};
+
+	// Prepares `sql` once per connection and rebinds it on later calls. Callers build the text from the matching type
+	// and promotion strategy, so each combination gets its own plan. A statement that is still borrowed (a nested
+	// query) or one past the cache's capacity is prepared fresh. On failure the statement is empty and the error
+	// is on the connection.
+	Statement prepare(const std::string& sql) const;
+	size_t cached_statements() const { return statements.size(); }
 
 private:
+	bool read_only;
 	mutable sqlite::database db;
 	
 	const Config& config;
 	PathsTable paths_table;
 	ShortcutsTable shortcuts_table;
+
+	std::function<bool()> should_abort;
+	bool aborted = false;
+
+	std::unique_ptr<QueryCache> query_cache;
+
+	struct CachedStatement {
+		std::unique_ptr<sqlite3_stmt, decltype(&sqlite3_finalize)> stmt;
+		// Map nodes never move, so a borrowed Statement can point straight at this
+		bool in_use = false;
+	};
+	// Declared after db so every statement is finalized before the connection closes
+	mutable std::unordered_map<std::string, CachedStatement> statements;
+	static constexpr size_t MAX_CACHED_STATEMENTS = 64;
+
+	static sqlite::database open(const std::string& db_path, bool& read_only);
+	int schema_version() const;
+	void migrate();
 };
 
 #endif // DATABASE_H
\ No newline at end of file
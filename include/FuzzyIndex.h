@@ -0,0 +1,62 @@
+#ifndef FUZZY_INDEX_H
+#define FUZZY_INDEX_H
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct sqlite3;
+
+
+// In-memory columnar copy of the paths table for fuzzy matching. Every dir_name is packed into
+// one buffer next to a per-row character mask, so a vectorized prefilter can drop rows that are
+// missing any character of the query before the (much slower) subsequence scorer looks at them.
+class FuzzyIndex {
+public:
+	struct Match {
+		int64_t id;
+		bool exact;
+		int score;
+		int64_t rank;
+	};
+
+	// fzf-style score of `pattern` as an ordered, case-insensitive subsequence of `text`, with bonuses
+	// for matches on word boundaries and in consecutive runs; nullopt when it isn't a subsequence
+	static std::optional<int> score(std::string_view pattern, std::string_view text);
+	// Bit per folded letter and digit, plus a few shared bits for every other byte
+	static uint64_t char_mask(std::string_view text);
+
+	// Reloads the columns if paths changed since the last load, on this connection or another one
+	void sync(sqlite3* connection);
+	// Applies an access this connection just wrote, so a single UPDATE doesn't force a full reload
+	void touch(sqlite3* connection, int64_t id, int64_t last_accessed, int64_t access_count);
+	// Accepts the writes this connection made since `since` (a total_changes count) as ones that left paths alone
+	void skip_changes(sqlite3* connection, int64_t since);
+
+	// The best `limit` matches, best first: exact names, then score, then last_accessed or access_count.
+	// `should_abort` is polled between blocks of rows; an aborted search returns what it has so far.
+	std::vector<Match> top_k(std::string_view pattern, size_t limit, bool by_frequency,
+		const std::function<bool()>& should_abort = nullptr) const;
+
+	size_t size() const { return ids.size(); }
+
+private:
+	std::string names;
+	std::vector<uint32_t> offsets;
+	std::vector<uint64_t> masks;
+	std::vector<int64_t> ids;
+	std::vector<int64_t> last_accessed;
+	std::vector<int64_t> access_counts;
+
+	bool loaded = false;
+	int64_t data_version = 0;
+	int64_t total_changes = 0;
+
+	void load(sqlite3* connection);
+	std::string_view name(size_t row) const { return std::string_view(names).substr(offsets[row], offsets[row + 1] - offsets[row]); }
+};
+
+#endif // FUZZY_INDEX_H
@@ -8,18 +8,20 @@ class Handler {
 public:
 	Handler(Database& db, const std::string& version = "1.0.1");
 
-	int handle_tab(int argc, char* argv[]);
-	int handle_enter(std::vector<std::string>& commands, std::vector<Flag>& flags);
+	// Results (completions, or the shell command for dv to eval) are written to `out`; diagnostics go to std::cerr
+	int handle_call(int argc, char* argv[], std::ostream& out = std::cout);
+	int handle_tab(int argc, char* argv[], std::ostream& out = std::cout);
+	int handle_enter(std::vector<std::string>& commands, std::vector<Flag>& flags, std::ostream& out = std::cout);
 
 	struct Subcommands {
-		static int handle_re_build(Handler& handler, std::vector<std::string>& commands, std::vector<Flag>& flags);
-		static int handle_refresh(Handler& handler, std::vector<std::string>& commands, std::vector<Flag>& flags);
-		static int handle_install(Handler& handler, std::vector<std::string>& commands, std::vector<Flag>& flags);
-		static int handle_init(Handler& handler, std::vector<std::string>& commands, std::vector<Flag>& flags);
-		static int handle_add(Handler& handler, std::vector<std::string>& commands, std::vector<Flag>& flags);
-		static int handle_delete(Handler& handler, std::vector<std::string>& commands, std::vector<Flag>& flags);
-		static int handle_list(Handler& handler, std::vector<std::string>& commands, std::vector<Flag>& flags);
-		static int handle_show(Handler& handler, std::vector<std::string>& commands, std::vector<Flag>& flags);
+		static int handle_re_build(Handler& handler, std::vector<std::string>& commands, std::vector<Flag>& flags, std::ostream& out);
+		static int handle_refresh(Handler& handler, std::vector<std::string>& commands, std::vector<Flag>& flags, std::ostream& out);
+		static int handle_install(Handler& handler, std::vector<std::string>& commands, std::vector<Flag>& flags, std::ostream& out);
+		static int handle_init(Handler& handler, std::vector<std::string>& commands, std::vector<Flag>& flags, std::ostream& out);
+		static int handle_add(Handler& handler, std::vector<std::string>& commands, std::vector<Flag>& flags, std::ostream& out);
+		static int handle_delete(Handler& handler, std::vector<std::string>& commands, std::vector<Flag>& flags, std::ostream& out);
+		static int handle_list(Handler& handler, std::vector<std::string>& commands, std::vector<Flag>& flags, std::ostream& out);
+		static int handle_show(Handler& handler, std::vector<std::string>& commands, std::vector<Flag>& flags, std::ostream& out);
 	};
 
 	
@@ -28,6 +30,9 @@ public:
 private:
 	Database& db;
 	const std::string version;
+
+	// Several plain words whose first isn't a known command: `dv proj api`
+	static bool is_keyword_query(const std::vector<std::string>& tokens);
 };
 
 #endif // HANDLER_H
\ No newline at end of file
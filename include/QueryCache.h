@@ -0,0 +1,66 @@
+#ifndef QUERY_CACHE_H
+#define QUERY_CACHE_H
+
+#include "utils/Types.h"
+
+#include <sqlite_modern_cpp.h>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+
+// Completion results remembered per request, so pressing Tab again on the same partial skips the query. Entries are
+// tagged with the index generation (see PathsTable::generation) they were computed at and only count while it is
+// current; past CAPACITY the least recently used go. Completions open the index read-only, so the cache is a small
+// SQLite file of its own next to it. Failures are silent: without the cache the query simply runs.
+//
+// A lookup only reads: hits and misses are counted in a mapped file beside the cache, and the hits' recency is written
+// with this process's next store(). A process that only hits (one Tab, answered from the cache) doesn't refresh it.
+class QueryCache {
+public:
+	struct Key {
+		std::string query;
+		MatchingType matching_type;
+		PromotionStrategy strategy;
+		int max_results;
+		int64_t generation;
+	};
+
+	struct Stats {
+		int64_t entries = 0;
+		int64_t hits = 0;
+		int64_t misses = 0;
+	};
+
+	static constexpr int64_t CAPACITY = 256;
+	// Kept in the file's user_version; the tables are only (re)created when it doesn't match
+	static constexpr int SCHEMA_VERSION = 1;
+
+	explicit QueryCache(const std::string& path);
+	~QueryCache();
+
+	QueryCache(const QueryCache&) = delete;
+	QueryCache& operator=(const QueryCache&) = delete;
+
+	// The results stored for `key`, each followed by a NUL; counts a hit or a miss
+	std::optional<std::string> lookup(const Key& key);
+	void store(const Key& key, const std::string& results);
+	Stats stats() const;
+
+private:
+	// Null when the file couldn't be opened
+	std::unique_ptr<sqlite::database> db;
+	const std::string counters_path;
+	// { hits, misses }, mapped on first use
+	uint64_t* counters = nullptr;
+	// Hits whose recency hasn't been written yet
+	std::vector<Key> touched;
+	bool writing = false;
+
+	void count(size_t counter);
+};
+
+#endif // QUERY_CACHE_H
@@ -0,0 +1,37 @@
+#ifndef REQUEST_GENERATION_H
+#define REQUEST_GENERATION_H
+
+#include <cstdint>
+#include <string>
+
+
+// Per-terminal generation counter shared by every `dv-binary --tab` started from the same tty.
+// Each invocation bumps the counter when it starts; once a newer one has started, the older
+// one's answer is obsolete and it can stop early. The counter lives in a small mmap'ed runtime
+// file, so checking it is a single memory load.
+class RequestGeneration {
+public:
+	// Claims the next generation for `key`. With an empty key (or if the counter file cannot be
+	// mapped) the request is never superseded.
+	explicit RequestGeneration(const std::string& key);
+	// Watches a generation another process claimed for `key`, as the daemon does for the requests it is forwarded
+	RequestGeneration(const std::string& key, uint64_t generation);
+	~RequestGeneration();
+
+	RequestGeneration(const RequestGeneration&) = delete;
+	RequestGeneration& operator=(const RequestGeneration&) = delete;
+
+	bool superseded() const;
+	const std::string& get_key() const { return key; }
+	uint64_t get_generation() const { return generation; }
+
+	// Identifies the controlling terminal from stdin/stderr ("" when there is none)
+	static std::string tty_key();
+
+private:
+	std::string key;
+	uint64_t* counter = nullptr;
+	uint64_t generation = 0;
+};
+
+#endif // REQUEST_GENERATION_H
@@ -0,0 +1,41 @@
+#ifndef STDIO_SERVER_H
+#define STDIO_SERVER_H
+
+#include "Handler.h"
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+// Batch mode for `dv-binary --serve-stdio`: answers a stream of requests with one warm Handler so a
+// zsh coproc or an editor plugin can run thousands of lookups without starting a process for each.
+//
+// Requests:
+//   line mode (default)  one request per line, words separated by spaces; a backslash escapes the next character
+//   NUL mode (-0)        every word is terminated by a NUL; an empty word ends the request
+// The first word is the verb:
+//   tab <words...>    same as `dv-binary --tab <words...>` (the words include the command name, e.g. `tab dv proj`);
+//                     in NUL mode the candidates are NUL-separated as with --tab0
+//   enter <words...>  same as `dv-binary --enter dv <words...>`
+// Each response is whatever the handler printed followed by END_MARKER, the exit status and the delimiter
+// ('\n' or '\0'), and the stream is flushed after every response.
+class StdioServer {
+public:
+	static constexpr char END_MARKER = '\x1e';
+
+	StdioServer(Handler& handler, bool nul_delimited = false);
+
+	// Serves requests until `in` is exhausted
+	int serve(std::istream& in, std::ostream& out);
+
+private:
+	Handler& handler;
+	bool nul_delimited;
+
+	bool read_request(std::istream& in, std::vector<std::string>& words) const;
+	int handle_request(std::vector<std::string>& words, std::ostream& out);
+};
+
+#endif // STDIO_SERVER_H
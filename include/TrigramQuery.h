@@ -0,0 +1,38 @@
+#ifndef TRIGRAM_QUERY_H
+#define TRIGRAM_QUERY_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+// The substrings any match of a regular expression must contain, as an AND/OR tree of literals, after Russ Cox's
+// "Regular Expression Matching with a Trigram Index". Every text the regex matches satisfies the query, so it can
+// pick candidates out of a trigram index before the regex itself runs; a query of All means no literal is required.
+class TrigramQuery {
+public:
+	enum class Op { All, Literal, And, Or };
+
+	Op op = Op::All;
+	std::string literal;
+	std::vector<TrigramQuery> children;
+
+	// Analyzes an ECMAScript regex, matched case-insensitively. In `key_domain` the query is over match keys
+	// (Unicode::match_key) rather than raw text: separators drop out and literals may not end where a combining
+	// mark could join them. Syntax the analysis doesn't understand only weakens the query, never breaks it.
+	static TrigramQuery from_regex(std::string_view pattern, bool key_domain);
+
+	static TrigramQuery all() { return {}; }
+	static TrigramQuery of(std::string literal);
+	static TrigramQuery both(TrigramQuery a, TrigramQuery b);
+	static TrigramQuery either(TrigramQuery a, TrigramQuery b);
+
+	// FTS5 MATCH expression for a trigram-tokenized table ("" for All)
+	std::string to_fts() const;
+	// SQL condition on `column` built from instr(), with the literals appended to `binds` ("" for All)
+	std::string to_sql(const std::string& column, std::vector<std::string>& binds) const;
+
+	bool operator==(const TrigramQuery& other) const = default;
+};
+
+#endif // TRIGRAM_QUERY_H
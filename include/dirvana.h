@@ -0,0 +1,73 @@
+#ifndef DIRVANA_C_API_H
+#define DIRVANA_C_API_H
+
+/*
+ * C API for libdirvana: keep an index open and query it in-process instead of running dv-binary.
+ *
+ * All functions may be called from any thread. Calls on the same handle are serialized; use one
+ * handle per thread for parallel queries (read-only handles never block each other on the database).
+ *
+ *   dv_handle* dv = dv_open(NULL, DV_OPEN_READ_ONLY);
+ *   char buffer[4096];
+ *   size_t used, count;
+ *   if (dv_query(dv, "proj", buffer, sizeof(buffer), &used, &count) == DV_OK)
+ *       for (const char* path = buffer; path < buffer + used; path += strlen(path) + 1)
+ *           puts(path);
+ *   dv_close(dv);
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define DV_API __attribute__((visibility("default")))
+#else
+#define DV_API
+#endif
+
+#define DV_API_VERSION 1
+
+typedef struct dv_handle dv_handle;
+
+enum dv_status {
+	DV_OK = 0,
+	DV_ERROR = 1,               /* details in dv_last_error() */
+	DV_BUFFER_TOO_SMALL = 2,    /* *used holds the size that would have been needed */
+	DV_READ_ONLY = 3            /* the handle was opened with DV_OPEN_READ_ONLY */
+};
+
+enum dv_open_flags {
+	DV_OPEN_READ_ONLY = 1 << 0
+};
+
+/* Opens the index described by config_path (NULL for the default config). Returns NULL on failure. */
+DV_API dv_handle* dv_open(const char* config_path, int flags);
+
+/*
+ * Writes the matches for `partial` (best first) into the caller's buffer as consecutive NUL-terminated
+ * strings, the same candidates `dv-binary --tab dv <partial>` prints for a single word. *used is the number
+ * of bytes written and *count the number of matches. A partial ending in '/' lists the files in that
+ * directory instead, and an abbreviated absolute path (~/Co/Pr) is expanded. Keyword queries (dv -k) take
+ * several words and have no equivalent here.
+ */
+DV_API int dv_query(dv_handle* handle, const char* partial, char* buffer, size_t buffer_size, size_t* used, size_t* count);
+
+/* Records a visit to `path` so it ranks higher in later queries */
+DV_API int dv_access(dv_handle* handle, const char* path);
+
+/* Rescans `root` (NULL for the configured root) and updates the index in place */
+DV_API int dv_refresh(dv_handle* handle, const char* root);
+
+DV_API void dv_close(dv_handle* handle);
+
+/* Message for the most recent DV_ERROR on the calling thread */
+DV_API const char* dv_last_error(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DIRVANA_C_API_H */
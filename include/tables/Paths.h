@@ -2,16 +2,49 @@
 #define PATHS_TABLE_H
 
 #include "Table.h"
+#include "FuzzyIndex.h"
 #include "utils/Types.h"
 
+#include <functional>
+#include <string_view>
+
 class PathsTable : public Table {
 public:
 		PathsTable(Database& db) : Table(db) {}
 
 		void create_table() const override;
 		void drop_table() const override;
+		// create_table without its own transaction, for migrations that have to apply completely or not at all (throws on failure)
+		void create_schema() const;
+		// Repopulates derived keys and indexes (folded and reversed names, the trigram table) from the rows already in
+		// paths. Part of the caller's transaction, like create_schema.
+		void rebuild_indexes() const;
+		// Recomputes the component -> path id posting lists behind for_each_keyword_match from paths. Runs inside the
+		// transaction that wrote the rows (throws on failure), so readers never see one without the other.
+		void rebuild_components() const;
+		// Recounts the key grams in match_stats, relists the best rows for each in top_matches and refreshes SQLite's
+		// own statistics, for planning and answering short queries. Like rebuild_components, part of the caller's transaction.
+		void rebuild_stats() const;
+		// Moves the index generation forward; rebuild_stats and access call it inside their transactions (throws on failure)
+		void bump_generation() const;
+		// Changes whenever the indexed paths or their ranks change, and never repeats. 0 while match_stats is missing
+		// (before anything was indexed, or mid-rebuild), when nothing should be cached.
+		int64_t generation() const;
 		std::vector<std::string> query(const std::string& input) const override;
-		void access(const std::string& input) override;
+		// Streams the ranked matches for `input`; each view points into SQLite's row buffer and is only valid during the call
+		size_t for_each_match(const std::string& input, const std::function<void(std::string_view)>& visit) const;
+		// Expands an absolute (or ~) path whose segments are name prefixes, fish-style: ~/Co/Pr/di -> ~/Code/Projects/dirvana.
+		// Only the index is consulted; leading segments with no indexed children are taken literally.
+		size_t for_each_expansion(const std::string& abbreviated, const std::function<void(std::string_view)>& visit) const;
+		// Paths whose dir_name (or whole path, when the pattern has a '/') matches an ECMAScript regex, case-insensitively.
+		// Candidates come from the trigram index using the literals every match must contain (see TrigramQuery).
+		size_t for_each_regex_match(const std::string& pattern, const std::function<void(std::string_view)>& visit) const;
+		// Paths with components containing each keyword, in order and case-insensitively, the last keyword in the leaf
+		size_t for_each_keyword_match(const std::vector<std::string>& keywords, const std::function<void(std::string_view)>& visit) const;
+		// Distinct dir_name match keys within `max_distance` edits (insertions, deletions, substitutions and adjacent
+		// transpositions) of `needle`, closest first
+		std::vector<std::pair<int, std::string>> similar_names(const std::string& needle, int max_distance) const;
+		bool access(const std::string& input) override;
 		
 		std::vector<std::tuple<std::string, std::string>> collect_directories(const std::string& init_path);
 		std::vector<std::string> collect_files(const std::string& init_path) const;
@@ -22,6 +55,24 @@ public:
 		void delete_paths(const std::vector<std::string>& paths);
 		bool should_exclude(const std::string& dir_name, const std::string& path, const std::vector<ExclusionRule>& rules) const;
 		void select_all_paths(std::function<void(std::string)> callback) const;
+
+private:
+		// Fuzzy matching can't be expressed in SQL, so it runs over a copy of the table kept in memory
+		mutable FuzzyIndex fuzzy_index;
+		// Keys up to this many bytes are planned from match_stats; longer ones are selective enough to always filter
+		static constexpr size_t SHORT_KEY_BYTES = 4;
+
+		// Upper bound on the names a key matches under `type`, and the number of names; false without statistics
+		bool estimate_matches(MatchingType type, const std::string& key, int64_t& matches, int64_t& names) const;
+		// Whether top_matches lists the best `limit` rows for `gram` (or every row that has it)
+		bool serves_top_matches(const std::string& gram, PromotionStrategy strategy, size_t limit) const;
+
+		size_t for_each_fuzzy_match(const std::string& dir_name, const std::function<void(std::string_view)>& visit) const;
+		// Rows whose keys are a few edits from `key`, minus those the first pass returned: keys `already_matched` accepts,
+		// and rows with `initials` as their initialism
+		size_t for_each_typo_match(const std::string& key, const std::string& initials,
+			const std::function<bool(std::string_view)>& already_matched, const std::string& sort_col, size_t limit,
+			const std::function<void(std::string_view)>& visit) const;
 };
 
 #endif // PATHS_TABLE_H
\ No newline at end of file
@@ -9,13 +9,18 @@ public:
 
 		void create_table() const override;
 		void drop_table() const override;
+		// create_table inside the caller's transaction (throws on failure)
+		void create_schema() const;
 		std::vector<std::string> query(const std::string& input) const override;
-		void access(const std::string& input) override;
+		bool access(const std::string& input) override;
 
 		void add_shortcut(const std::string& shortcut, const std::string& command);
 		void delete_shortcut(const std::string& shortcut);
 		std::vector<std::string> select_all_shortcuts() const;
 		std::string select_shortcut_command(const std::string& shortcut) const;
+
+private:
+		bool select_command(const std::string& shortcut, std::string& command, const char* error_prefix) const;
 };
 
 #endif // SHORTCUTS_TABLE_H
\ No newline at end of file
@@ -13,7 +13,8 @@ public:
 	virtual void create_table() const = 0;
 	virtual void drop_table() const = 0;
 	virtual std::vector<std::string> query(const std::string& input) const = 0;
-	virtual void access(const std::string& input) = 0;
+	// False (after printing why) when the visit couldn't be recorded
+	virtual bool access(const std::string& input) = 0;
 	
 	Database& db;
 
@@ -3,16 +3,47 @@
 
 #include <json.hpp>
 #include "Types.h"
+#include "StaticMap.h"
 
+#include <cstdint>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <chrono>
-#include <unordered_set>
 
 using json = nlohmann::json;
 
 std::string get_dir_name(const std::string& path);
+// Everything before the last '/' ("" for a top-level path)
+std::string get_parent_path(const std::string& path);
 std::string extract_promotion_strategy(const std::string& dirname);
+// Unicode::match_key(text) with its UTF-8 characters in reverse order, so a suffix of a name becomes a prefix of its key
+std::string reversed_key(std::string_view text);
+// First character of every word in a name, in match key form (see Unicode::match_key): PaymentGatewayAdapter and payment-gateway-adapter both give
+// "pga". Words break at '-', '_', '.' and spaces, at lower-to-upper case changes, before the last capital of an
+// acronym (HTTPServer is "hs") and where digits start. Names that are a single word have no initialism ("").
+std::string initialism(std::string_view name);
+// One bit (of 64) per pair of adjacent bytes in `key`. A text containing `key` has every bit of its signature,
+// so (signature(text) & signature(key)) == signature(key) is a cheap necessary test before a substring search.
+int64_t bigram_signature(std::string_view key);
+// Smallest string that sorts after every string starting with `prefix` ("" when there is no such bound)
+std::string prefix_successor(std::string prefix);
+// Whether `path` has components whose match keys contain each of `keywords` (already keys) in order, the last one in its leaf
+bool components_in_order(const std::string& path, const std::vector<std::string>& keywords);
+// Whether the shell would run `name` as a command: a common builtin, or an executable somewhere on $PATH
+bool is_command(const std::string& name);
+// Per-user location for runtime files: $XDG_RUNTIME_DIR/dirvana<suffix>, or $TMPDIR/dirvana-<uid><suffix>
+std::string runtime_path(const std::string& suffix);
+// `count` counters shared between processes through a small file mapped into memory (munmap them with
+// count * sizeof(uint64_t)). A new file starts at zero; null if the file can't be mapped, or is missing and not `create`d.
+uint64_t* map_counters(const std::string& path, size_t count, bool create);
+
+// Sorted id lists stored as LEB128 varints of the gaps between consecutive ids
+namespace Postings {
+	std::string encode(const std::vector<int64_t>& sorted_ids);
+	void decode(std::string_view encoded, std::vector<int64_t>& ids);
+};
 
 namespace TypeConversions {
 	MatchingType s_to_matching_type(const std::string& type);
@@ -26,7 +57,8 @@ namespace TypeConversions {
 };
 
 namespace ArgParsing {
-	static const std::unordered_map<std::string, std::string> flag_aliases = {
+	// All lookup tables are constexpr perfect-hash maps, so nothing is built at static-init time
+	inline constexpr auto flag_aliases = make_static_map<std::string_view>({
 		{"v", "version"},
 		{"h", "help"},
 		{"r", "root"},
@@ -36,9 +68,10 @@ namespace ArgParsing {
 		{"s", "suffix"},
 		{"c", "contains"},
 		{"ra", "recently_accessed"},
-		{"fb", "frequency_based"}
-	};
-	static const std::vector<std::string> full_flag_names = {
+		{"fb", "frequency_based"},
+		{"k", "keywords"}
+	});
+	inline constexpr auto full_flag_names = make_static_set({
 		"version",
 		"help",
 		"root",
@@ -49,22 +82,30 @@ namespace ArgParsing {
 		"contains",
 		"recently_accessed",
 		"frequency_based",
+		"regex",
+		"cache-stats",
+		"keywords",
 		"[bypass]" // converted version of '--'
-	};
-	static const std::unordered_map<std::string, std::vector<std::pair<std::string, bool>>> valid_flags = {
+	});
+	// (flag, requires value)
+	struct FlagSpec { std::string_view name; bool requires_value; };
+	inline constexpr FlagSpec global_flags[] = {{"version", false}, {"regex", true}, {"cache-stats", false}, {"keywords", false},
+		{"[bypass]", true}};
+	inline constexpr FlagSpec build_flags[] = {{"root", true}, {"force", false}};
+	inline constexpr FlagSpec refresh_flags[] = {{"root", true}};
+	inline constexpr auto valid_flags = make_static_map<std::span<const FlagSpec>>({
 		// Build/rebuild/refresh command flags
-		// (flag, requires value)
-	{"", {{"version", false}, {"[bypass]", true}}},
-	{"build", {{"root", true}, {"force", false}}},
-	{"rebuild", {{"root", true}, {"force", false}}},
-	{"refresh", {{"root", true}}}
-	};
-	static const std::unordered_map<std::string, std::string> raw_flag_to_implied = {
+		{"", global_flags},
+		{"build", build_flags},
+		{"rebuild", build_flags},
+		{"refresh", refresh_flags}
+	});
+	inline constexpr auto raw_flag_to_implied = make_static_map<std::string_view>({
 		{"--", "--[bypass]"}
-	};
+	});
 	// First token after "dv": if it matches here, argv is passed through without Dirvana flag parsing
 	// (e.g. cp -r, rm -rf). Omit Dirvana subcommands: build, rebuild, refresh, install, add, delete, list, show.
-	static const std::unordered_set<std::string> system_shell_commands = {
+	inline constexpr auto system_shell_commands = make_static_set({
 		"awk", "bash", "brew", "bun", "bunx", "cat", "cd", "chflags", "chmod", "chown", "cp", "curl", "cut",
 		"date", "dd", "diff", "dig", "dirname", "diskutil", "docker", "du", "ed", "env", "ex", "false", "fd",
 		"ffmpeg", "fgrep", "file", "find", "fish", "grimoire", "g++", "gcc", "gem", "gh", "git", "gmake", "grep", "gunzip",
@@ -74,8 +115,8 @@ namespace ArgParsing {
 		"say", "scp", "sed", "seq", "sh", "sort", "ssh", "stat", "sudo", "svn", "swift", "tail", "tar", "tee",
 		"terraform", "test", "time", "top", "touch", "tr", "true", "uname", "unzip", "vim", "vi", "wc", "wget",
 		"which", "whoami", "xargs", "xattr", "yarn", "yes", "zip", "zsh"
-	};
-	std::pair<bool, Flag> build_flag(const std::vector<std::string>& flag_parts, const std::string& cmd);
+	});
+	std::pair<bool, Flag> build_flag(std::string_view raw_flag, std::string_view value, std::string_view cmd);
 	std::tuple<bool, std::vector<std::string>, std::vector<Flag>> process_args(int argc, char* argv[]);
 	bool validate_flag(const Flag& flag);
 	std::string get_flag_value(const std::vector<Flag>& flags, const std::string& flag_name, const std::string& default_value = "");
@@ -90,6 +131,11 @@ namespace Time {
 
 		return micros_since_epoch.count();
 	};
+
+	// Steady clock reading that is comparable across processes on the same machine (used for phase timings)
+	inline long long monotonic_ns() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	};
 }
 
 #endif // HELPERS_H
\ No newline at end of file
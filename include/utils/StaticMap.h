@@ -0,0 +1,134 @@
+#ifndef STATIC_MAP_H
+#define STATIC_MAP_H
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+
+
+// Immutable string-keyed table with a perfect hash computed at compile time (hash-and-displace:
+// every first-level bucket gets its own seed that sends its keys to free slots). Lookups are a
+// single probe plus one key comparison, with no static initializer and no allocation.
+template <typename Value, size_t N>
+class StaticMap {
+public:
+	using Entry = std::pair<std::string_view, Value>;
+
+	constexpr StaticMap(const std::array<Entry, N>& entries) : entries(entries) { build(); }
+
+	constexpr const Value* find(std::string_view key) const {
+		int16_t index = slots[slot_of(key, seeds[hash(key, 0) % BUCKETS])];
+		return index >= 0 and entries[index].first == key ? &entries[index].second : nullptr;
+	}
+	constexpr bool contains(std::string_view key) const { return find(key) != nullptr; }
+
+	constexpr auto begin() const { return entries.begin(); }
+	constexpr auto end() const { return entries.end(); }
+	constexpr size_t size() const { return N; }
+
+private:
+	static constexpr size_t BUCKETS = N;
+	static constexpr size_t MAX_BUCKET = 16;
+	static constexpr size_t SLOTS = [] {
+		size_t slots = 1;
+		while (slots < 4 * N) slots <<= 1;
+		return slots;
+	}();
+
+	std::array<Entry, N> entries{};
+	std::array<uint64_t, BUCKETS> seeds{};
+	std::array<int16_t, SLOTS> slots{};
+
+	// FNV-1a with a seeded basis and a final mix so the low bits depend on every byte
+	static constexpr uint64_t hash(std::string_view key, uint64_t seed) {
+		uint64_t h = 0xcbf29ce484222325ULL ^ (seed * 0x9e3779b97f4a7c15ULL);
+		for (char c : key) {
+			h ^= static_cast<unsigned char>(c);
+			h *= 0x100000001b3ULL;
+		}
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdULL;
+		h ^= h >> 33;
+		return h;
+	}
+
+	static constexpr size_t slot_of(std::string_view key, uint64_t seed) { return hash(key, seed) & (SLOTS - 1); }
+
+	constexpr void build() {
+		slots.fill(-1);
+
+		// Group the keys by first-level bucket
+		std::array<size_t, BUCKETS + 1> bucket_start{};
+		std::array<size_t, N> bucket_of{};
+		for (size_t i = 0; i < N; i++) {
+			bucket_of[i] = hash(entries[i].first, 0) % BUCKETS;
+			bucket_start[bucket_of[i] + 1]++;
+		}
+		for (size_t b = 0; b < BUCKETS; b++)
+			bucket_start[b + 1] += bucket_start[b];
+		std::array<size_t, N> members{};
+		std::array<size_t, BUCKETS> filled{};
+		for (size_t i = 0; i < N; i++)
+			members[bucket_start[bucket_of[i]] + filled[bucket_of[i]]++] = i;
+
+		// Place the largest buckets first, while the table is still mostly empty
+		size_t largest = 0;
+		for (size_t b = 0; b < BUCKETS; b++)
+			largest = filled[b] > largest ? filled[b] : largest;
+		if (largest > MAX_BUCKET)
+			throw "StaticMap: too many keys share a bucket";
+		std::array<size_t, BUCKETS> order{};
+		size_t ordered = 0;
+		for (size_t size = largest; size > 0; size--)
+			for (size_t b = 0; b < BUCKETS; b++)
+				if (filled[b] == size)
+					order[ordered++] = b;
+
+		for (size_t o = 0; o < ordered; o++) {
+			size_t b = order[o];
+			size_t count = filled[b];
+
+			for (uint64_t seed = 1;; seed++) {
+				// Two equal keys can never be separated, so this turns into a compile error
+				if (seed > 1000000)
+					throw "StaticMap: duplicate key";
+
+				std::array<size_t, MAX_BUCKET> placed{};
+				bool fits = true;
+				for (size_t k = 0; k < count and fits; k++) {
+					placed[k] = slot_of(entries[members[bucket_start[b] + k]].first, seed);
+					fits = slots[placed[k]] < 0;
+					for (size_t m = 0; m < k and fits; m++)
+						fits = placed[m] != placed[k];
+				}
+				if (not fits)
+					continue;
+
+				for (size_t k = 0; k < count; k++)
+					slots[placed[k]] = static_cast<int16_t>(members[bucket_start[b] + k]);
+				seeds[b] = seed;
+				break;
+			}
+		}
+	}
+};
+
+template <typename Value, size_t N>
+constexpr StaticMap<Value, N> make_static_map(const std::pair<std::string_view, Value> (&entries)[N]) {
+	std::array<std::pair<std::string_view, Value>, N> items{};
+	for (size_t i = 0; i < N; i++)
+		items[i] = entries[i];
+	return StaticMap<Value, N>(items);
+}
+
+// A set is a map whose values are never looked at
+template <size_t N>
+constexpr StaticMap<bool, N> make_static_set(const std::string_view (&keys)[N]) {
+	std::array<std::pair<std::string_view, bool>, N> items{};
+	for (size_t i = 0; i < N; i++)
+		items[i] = { keys[i], true };
+	return StaticMap<bool, N>(items);
+}
+
+#endif // STATIC_MAP_H
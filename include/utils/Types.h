@@ -22,7 +22,7 @@ struct DCArgs {
 };
 
 // Stores the available matching types for the cache
-enum class MatchingType { Exact, Prefix, Suffix, Contains };
+enum class MatchingType { Exact, Prefix, Suffix, Contains, Fuzzy, Regex };
 
 // Stores the available promotion strategies for the cache
 enum class PromotionStrategy {
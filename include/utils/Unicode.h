@@ -0,0 +1,15 @@
+#ifndef UNICODE_H
+#define UNICODE_H
+
+#include <string>
+#include <string_view>
+
+
+namespace Unicode {
+	// Key that names compare equal under when matching: NFC-composed, fully case-folded, and with the word
+	// separators '_', '-' and ' ' removed, so "Über_Service", "über-service" and "ÜberService" share one key.
+	// Invalid UTF-8 bytes are passed through unchanged.
+	std::string match_key(std::string_view text);
+};
+
+#endif // UNICODE_H
@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+"""Generates src/impl/utils/UnicodeTables.inc from Python's copy of the Unicode Character Database.
+
+    python3 scripts/gen_unicode_tables.py > src/impl/utils/UnicodeTables.inc
+"""
+import unicodedata
+import sys
+
+MAX_CODE_POINT = 0x110000
+
+
+def fold_tables():
+    # Single code point foldings, run-length encoded as (first, last, delta, stride)
+    singles, specials = [], []
+    for cp in range(MAX_CODE_POINT):
+        folded = chr(cp).casefold()
+        if folded == chr(cp):
+            continue
+        if len(folded) == 1:
+            singles.append((cp, ord(folded) - cp))
+        else:
+            specials.append((cp, [ord(c) for c in folded]))
+
+    ranges = []
+    for cp, delta in singles:
+        if ranges:
+            first, last, d, stride = ranges[-1]
+            if d == delta and (stride == 0 or cp - last == stride) and cp - last in (1, 2):
+                ranges[-1] = (first, cp, d, cp - last)
+                continue
+        ranges.append((cp, cp, delta, 0))
+    return [(f, l, d, s or 1) for f, l, d, s in ranges], specials
+
+
+def compositions():
+    pairs = []
+    for cp in range(MAX_CODE_POINT):
+        decomposition = unicodedata.decomposition(chr(cp))
+        if not decomposition or decomposition.startswith('<'):
+            continue
+        parts = [int(p, 16) for p in decomposition.split()]
+        # Primary composites only: singletons and composition exclusions never come out of NFC
+        if len(parts) == 2 and unicodedata.normalize('NFC', chr(parts[0]) + chr(parts[1])) == chr(cp):
+            pairs.append((parts[0], parts[1], cp))
+    return sorted(pairs)
+
+
+def main():
+    ranges, specials = fold_tables()
+    pairs = compositions()
+    out = sys.stdout
+    out.write('// Generated by scripts/gen_unicode_tables.py from Unicode %s. Do not edit.\n\n' % unicodedata.unidata_version)
+    out.write('// Simple case foldings: every `stride`-th code point in [first, last] folds to itself + delta\n')
+    out.write('static constexpr FoldRange FOLD_RANGES[] = {\n')
+    for first, last, delta, stride in ranges:
+        out.write('\t{ 0x%04X, 0x%04X, %d, %d },\n' % (first, last, delta, stride))
+    out.write('};\n\n')
+    out.write('// Full case foldings that expand to more than one code point\n')
+    out.write('static constexpr FoldSpecial FOLD_SPECIALS[] = {\n')
+    for cp, folded in specials:
+        folded = folded + [0] * (3 - len(folded))
+        out.write('\t{ 0x%04X, { 0x%04X, 0x%04X, 0x%04X } },\n' % (cp, *folded))
+    out.write('};\n\n')
+    out.write('// Canonical compositions (starter, combining mark) -> primary composite, sorted\n')
+    out.write('static constexpr Composition COMPOSITIONS[] = {\n')
+    for starter, mark, composite in pairs:
+        out.write('\t{ 0x%04X, 0x%04X, 0x%04X },\n' % (starter, mark, composite))
+    out.write('};\n')
+
+
+if __name__ == '__main__':
+    main()
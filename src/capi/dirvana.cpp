@@ -0,0 +1,113 @@
+#include "dirvana.h"
+#include "Database.h"
+
+#include <cstring>
+#include <mutex>
+
+struct dv_handle {
+	std::mutex mutex;
+	Config config;
+	Database db;
+
+	dv_handle(const std::string& config_path, bool read_only) : config(config_path), db(config, read_only) {}
+};
+
+static thread_local std::string last_error;
+
+static int fail(const std::string& message) {
+	last_error = message;
+	return DV_ERROR;
+}
+
+
+extern "C" dv_handle* dv_open(const char* config_path, int flags) {
+	try {
+		return new dv_handle(config_path != nullptr ? config_path : "", flags & DV_OPEN_READ_ONLY);
+	} catch (const std::exception& e) {
+		fail(std::string("Error opening database: ") + e.what());
+		return nullptr;
+	}
+}
+
+
+extern "C" int dv_query(dv_handle* handle, const char* partial, char* buffer, size_t buffer_size, size_t* used, size_t* count) {
+	if (handle == nullptr or partial == nullptr or used == nullptr or count == nullptr)
+		return fail("dv_query: invalid argument");
+
+	std::vector<std::string> matches;
+	try {
+		std::lock_guard<std::mutex> lock(handle->mutex);
+		std::string input = partial;
+		// Same steps as tab completion for a single word: a trailing '/' asks for the files in that directory, and an
+		// absolute path may abbreviate its segments (~/Co/Pr)
+		if (not input.empty() and input.back() == '/') {
+			matches = handle->db.get_paths_table().collect_files(input);
+		} else {
+			if (input.starts_with('/') or input.starts_with('~'))
+				handle->db.get_paths_table().for_each_expansion(input, [&](std::string_view path) { matches.emplace_back(path); });
+			if (matches.empty())
+				matches = handle->db.get_paths_table().query(input);
+		}
+	} catch (const std::exception& e) {
+		return fail(std::string("Error querying paths: ") + e.what());
+	}
+
+	size_t needed = 0;
+	for (const auto& match : matches)
+		needed += match.size() + 1;
+	*used = needed;
+	*count = matches.size();
+	if (needed > buffer_size or (needed > 0 and buffer == nullptr))
+		return DV_BUFFER_TOO_SMALL;
+
+	for (const auto& match : matches) {
+		std::memcpy(buffer, match.c_str(), match.size() + 1);
+		buffer += match.size() + 1;
+	}
+	return DV_OK;
+}
+
+
+extern "C" int dv_access(dv_handle* handle, const char* path) {
+	if (handle == nullptr or path == nullptr)
+		return fail("dv_access: invalid argument");
+	if (handle->db.is_read_only())
+		return DV_READ_ONLY;
+
+	try {
+		std::lock_guard<std::mutex> lock(handle->mutex);
+		if (not handle->db.get_paths_table().access(path))
+			return fail(std::string("Failed to record access to ") + path);
+	} catch (const std::exception& e) {
+		return fail(std::string("Error accessing path: ") + e.what());
+	}
+	return DV_OK;
+}
+
+
+extern "C" int dv_refresh(dv_handle* handle, const char* root) {
+	if (handle == nullptr)
+		return fail("dv_refresh: invalid argument");
+	if (handle->db.is_read_only())
+		return DV_READ_ONLY;
+
+	try {
+		std::lock_guard<std::mutex> lock(handle->mutex);
+		std::string init_path = root != nullptr ? root : handle->config.get_init_path();
+		if (not handle->db.refresh(init_path))
+			return fail("Failed to refresh from " + init_path);
+	} catch (const std::exception& e) {
+		return fail(std::string("Error refreshing database: ") + e.what());
+	}
+	return DV_OK;
+}
+
+
+extern "C" void dv_close(dv_handle* handle) {
+	delete handle;
+}
+
+
+extern "C" const char* dv_last_error(void) {
+	return last_error.c_str();
+}
@@ -3,22 +3,26 @@
 #include <iostream>
 #include <filesystem>
 #include <fstream>
+#include <cstring>
+#include <unistd.h>
 
 
 Config::Config(const std::string& config_path) {
+	const char* home_env = std::getenv("HOME");
+	home = home_env != nullptr ? home_env : "";
+
 	// We only use this for testing purposes
-	if (not config_path.empty())
-		this->config_path = config_path;
+	this->config_path = not config_path.empty() ? config_path : home + "/Library/Application Support/dirvana/config.json";
 
 	// Check if HOME environment variable is set
-	if (std::getenv("HOME") == nullptr) {
+	if (home_env == nullptr) {
 		std::cerr << "HOME environment variable is not set. Please set it and try again." << std::endl;
 		return;
 	}
 
 	// If we haven't created a config file yet, or the user has deleted it, or they are pointing to a non-existent file, create a new config file
 	if (!std::filesystem::exists(this->config_path)) {
-		this->config = default_config;
+		set_config(default_config());
 
 		try {
 			// Create the parent directory if it doesn't exist
@@ -40,16 +44,24 @@ Config::Config(const std::string& config_path) {
 			return;
 		}
 
+		save_cache();
 		return;
 	}
 
+	// Fast path: the compiled snapshot is still current for this exact config.json, so skip parsing and validation
+	std::error_code ec;
+	auto mtime = std::filesystem::last_write_time(this->config_path, ec);
+	auto size = std::filesystem::file_size(this->config_path, ec);
+	if (!ec and load_cache(static_cast<int64_t>(mtime.time_since_epoch().count()), size))
+		return;
+
 	// Here, we can assume that the either our default config file exists in the default location or the user has provided a custom, valid path
 	try {
 		std::ifstream in_file(this->config_path);
 
 		// On failure to open the file, use the default config
 		if (!in_file.is_open()) {
-			this->config = default_config;
+			set_config(default_config());
 			return;
 		}
 
@@ -67,19 +79,128 @@ Config::Config(const std::string& config_path) {
 		}
 
 		// Return the (maybe) modified user config that is valid
-		this->config = user_config;
+		set_config(user_config);
+		save_cache();
 
 	} catch (const std::exception& e) {
 		
 		std::cerr << "Error reading config file: " << e.what() << ". Using default config." << std::endl;
-		this->config = default_config;
+		set_config(default_config());
 		std::cout << this->config.dump(4) << std::endl;
 		return;
 	}
 }
 
+json Config::default_config() const {
+	return {
+		{"paths", {
+			{"init", home + "/"},
+			{"db", home + "/Library/Application Support/dirvana/dirvana.db"}
+		}},
+		{"matching", {
+			{"max_results", 10},
+			{"max_history_size", 100},
+			{"type", "contains"},
+			{"promotion_strategy", "recently_accessed"},
+			{"exclusions", {
+				{"prefix", {"."}},
+				{"exact", {"node_modules", "browser_components", "dist", "out", "target", "tmp", "temp", "cache", "venv", "env", "obj", "pkg", "bin"}},
+				{"suffix", {"sdk", "Library"}},
+				{"contains", {"release"}}
+				}
+			}
+		}}
+	};
+}
+
+json& Config::load_json() const {
+	if (json_loaded)
+		return config;
+	json_loaded = true;
+
+	// The snapshot was compiled from a validated file, so the JSON only needs to be read back
+	try {
+		std::ifstream in_file(config_path);
+		if (in_file.is_open()) {
+			in_file >> config;
+			return config;
+		}
+	} catch (const std::exception& e) {
+		std::cerr << "Error reading config file: " << e.what() << ". Using default config." << std::endl;
+	}
+	config = default_config();
+	return config;
+}
+
+const std::vector<ExclusionRule>& Config::get_exclusion_rules() const {
+	if (!exclusion_rules)
+		exclusion_rules = generate_exclusion_rules(load_json()["matching"]["exclusions"]);
+	return *exclusion_rules;
+}
+
+void Config::compile(const json& user_config) {
+	const json paths = user_config.value("paths", json::object());
+	const json matching = user_config.value("matching", json::object());
+
+	snapshot = ConfigSnapshot{};
+	copy_path(snapshot.init_path, paths.value("init", std::string()));
+	copy_path(snapshot.db_path, paths.value("db", std::string()));
+	copy_path(snapshot.history_path, paths.value("history", std::string()));
+	snapshot.max_results = matching.value("max_results", snapshot.max_results);
+	snapshot.max_history_size = matching.value("max_history_size", snapshot.max_history_size);
+	snapshot.matching_type = TypeConversions::s_to_matching_type(matching.value("type", std::string("contains")));
+	snapshot.promotion_strategy = TypeConversions::s_to_promotion_strategy(matching.value("promotion_strategy", std::string("recently_accessed")));
+}
+
+void Config::copy_path(char (&dest)[PATH_MAX], const std::string& src) {
+	if (src.size() >= PATH_MAX)
+		std::cerr << "Config path is too long and will be truncated: " << src << std::endl;
+	size_t length = std::min(src.size(), static_cast<size_t>(PATH_MAX - 1));
+	std::memcpy(dest, src.data(), length);
+	dest[length] = '\0';
+}
+
+bool Config::load_cache(int64_t mtime, uint64_t size) {
+	std::ifstream in_file(cache_path(), std::ios::binary);
+	if (!in_file.is_open())
+		return false;
+
+	ConfigSnapshot cached;
+	in_file.read(reinterpret_cast<char*>(&cached), sizeof(cached));
+	if (in_file.gcount() != sizeof(cached) or cached.magic != ConfigSnapshot::MAGIC or cached.format != ConfigSnapshot::FORMAT or
+		cached.source_mtime != mtime or cached.source_size != size)
+		return false;
+
+	snapshot = cached;
+	return true;
+}
+
+void Config::save_cache() {
+	// Key the snapshot on the file as it is on disk now (after any rewrite by validation)
+	std::error_code ec;
+	auto mtime = std::filesystem::last_write_time(config_path, ec);
+	auto size = std::filesystem::file_size(config_path, ec);
+	if (ec)
+		return;
+	snapshot.source_mtime = static_cast<int64_t>(mtime.time_since_epoch().count());
+	snapshot.source_size = size;
+
+	// Write to a temporary file and rename it so concurrent invocations never read a partial snapshot
+	std::string tmp_path = cache_path() + "." + std::to_string(getpid());
+	{
+		std::ofstream out_file(tmp_path, std::ios::binary | std::ios::trunc);
+		if (!out_file.is_open())
+			return;
+		out_file.write(reinterpret_cast<const char*>(&snapshot), sizeof(snapshot));
+	}
+	std::filesystem::rename(tmp_path, cache_path(), ec);
+	if (ec)
+		std::filesystem::remove(tmp_path, ec);
+}
+
 bool Config::validate_config(json& user_config) const {
 	bool modified = false;
+	const json default_config = this->default_config();
 
 	// If "paths" key is missing, add it
 	if (!user_config.contains("paths")) {
@@ -118,7 +239,9 @@ bool Config::validate_config(json& user_config) const {
 		if (!user_config["matching"].contains("type") or (user_config["matching"]["type"].get<std::string>() != "exact" and
 			user_config["matching"]["type"].get<std::string>() != "prefix" and
 			user_config["matching"]["type"].get<std::string>() != "suffix" and
-			user_config["matching"]["type"].get<std::string>() != "contains")) {
+			user_config["matching"]["type"].get<std::string>() != "contains" and
+			user_config["matching"]["type"].get<std::string>() != "fuzzy" and
+			user_config["matching"]["type"].get<std::string>() != "regex")) {
 			user_config["matching"]["type"] = default_config["matching"]["type"];
 			modified = true;
 		}
@@ -0,0 +1,319 @@
+#include "Daemon.h"
+
+#include <charconv>
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Wire format (one request per connection):
+//   client -> daemon: version '\0' cwd '\0' tty key '\0' generation '\0' argv[1] '\0' ... argv[argc - 1] '\0',
+//                     then shutdown(SHUT_WR). The tty key and generation are empty unless a completion claimed one.
+//   daemon -> client: one status byte, the size of what the handler wrote to stderr in decimal, '\0', that stderr
+//                     output, then everything it wrote to stdout
+// A lone status byte of STATUS_RETRY tells the client to run the request in-process instead.
+static constexpr unsigned char STATUS_RETRY = 0xFF;
+static constexpr size_t HEADER_FIELDS = 4;
+static constexpr size_t MAX_REQUEST_SIZE = 64 * 1024;
+
+static volatile std::sig_atomic_t stop_requested = 0;
+
+static void on_stop_signal(int) { stop_requested = 1; }
+
+static bool write_all(int fd, const char* data, size_t size) {
+	while (size > 0) {
+		ssize_t n = ::write(fd, data, size);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			return false;
+		}
+		data += n;
+		size -= n;
+	}
+	return true;
+}
+
+static bool read_all(int fd, std::string& out, size_t limit) {
+	char buffer[4096];
+	while (out.size() < limit) {
+		ssize_t n = ::read(fd, buffer, sizeof(buffer));
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			return false;
+		}
+		if (n == 0) return true;
+		out.append(buffer, n);
+	}
+	return false;
+}
+
+static void send_reply(int fd, int status, const std::string& out = "", const std::string& err = "") {
+	std::string reply(1, static_cast<char>(status & 0x7F));
+	reply += std::to_string(err.size());
+	reply.push_back('\0');
+	reply += err;
+	reply += out;
+	write_all(fd, reply.data(), reply.size());
+}
+
+static void set_timeout(int fd, int option, int seconds) {
+	struct timeval tv = { seconds, 0 };
+	setsockopt(fd, SOL_SOCKET, option, &tv, sizeof(tv));
+}
+
+static bool make_address(struct sockaddr_un& addr) {
+	std::string path = Daemon::socket_path();
+	if (path.size() >= sizeof(addr.sun_path))
+		return false;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+	return true;
+}
+
+// Only the user that owns the daemon may talk to it (BSD ignores socket file permissions)
+static bool same_user(int fd) {
+#ifdef __APPLE__
+	uid_t uid; gid_t gid;
+	return getpeereid(fd, &uid, &gid) == 0 and uid == getuid();
+#else
+	struct ucred cred;
+	socklen_t len = sizeof(cred);
+	return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0 and cred.uid == getuid();
+#endif
+}
+
+
+Daemon::Daemon(const std::string& version, const std::string& config_path) : version(version), config_path(config_path) {}
+
+
+std::string Daemon::socket_path() {
+	return runtime_path(".sock");
+}
+
+
+bool Daemon::forward(int argc, char* argv[], const std::string& version, int& status, const RequestGeneration* generation) {
+	struct sockaddr_un addr;
+	if (!make_address(addr))
+		return false;
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		return false;
+
+	// Nothing listening (or a stale socket file): let the caller handle the request itself
+	if (connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0) {
+		close(fd);
+		return false;
+	}
+	set_timeout(fd, SO_RCVTIMEO, 5);
+
+	// Relative paths in the request (a `src/` partial) are relative to this process's directory, not the daemon's
+	std::error_code ec;
+	std::string cwd = std::filesystem::current_path(ec).string();
+	if (ec) {
+		close(fd);
+		return false;
+	}
+
+	std::string request = version;
+	request.push_back('\0');
+	request += cwd;
+	request.push_back('\0');
+	if (generation != nullptr and not generation->get_key().empty()) {
+		request += generation->get_key();
+		request.push_back('\0');
+		request += std::to_string(generation->get_generation());
+		request.push_back('\0');
+	} else {
+		request.append(2, '\0');
+	}
+	for (int i = 1; i < argc; i++) {
+		request += argv[i];
+		request.push_back('\0');
+	}
+
+	std::string reply;
+	bool ok = write_all(fd, request.data(), request.size()) and shutdown(fd, SHUT_WR) == 0 and
+		read_all(fd, reply, SIZE_MAX);
+	close(fd);
+
+	if (!ok or reply.empty() or static_cast<unsigned char>(reply[0]) == STATUS_RETRY)
+		return false;
+
+	size_t separator = reply.find('\0', 1);
+	size_t err_size = 0;
+	if (separator == std::string::npos or
+			std::from_chars(reply.data() + 1, reply.data() + separator, err_size).ptr != reply.data() + separator or
+			err_size > reply.size() - separator - 1)
+		return false;
+
+	status = static_cast<unsigned char>(reply[0]);
+	write_all(STDERR_FILENO, reply.data() + separator + 1, err_size);
+	write_all(STDOUT_FILENO, reply.data() + separator + 1 + err_size, reply.size() - separator - 1 - err_size);
+	return true;
+}
+
+
+int Daemon::serve() {
+	struct sockaddr_un addr;
+	if (!make_address(addr)) {
+		std::cerr << "Socket path is too long: " << socket_path() << std::endl;
+		return 1;
+	}
+
+	// Refuse to start twice; a socket that nobody answers on is left over from a crash
+	int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (connect(probe, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0) {
+		close(probe);
+		std::cerr << "A Dirvana daemon is already listening on " << addr.sun_path << std::endl;
+		return 1;
+	}
+	close(probe);
+	unlink(addr.sun_path);
+
+	int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	mode_t old_umask = umask(0077);
+	int bound = bind(listen_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
+	umask(old_umask);
+	if (listen_fd < 0 or bound != 0 or listen(listen_fd, 16) != 0) {
+		std::cerr << "Failed to listen on " << addr.sun_path << ": " << std::strerror(errno) << std::endl;
+		if (listen_fd >= 0) close(listen_fd);
+		return 1;
+	}
+
+	// No SA_RESTART so that a signal interrupts accept()
+	struct sigaction action = {};
+	action.sa_handler = on_stop_signal;
+	sigaction(SIGINT, &action, nullptr);
+	sigaction(SIGTERM, &action, nullptr);
+	signal(SIGPIPE, SIG_IGN);
+
+	stop_requested = 0;
+	while (not stop_requested) {
+		int client_fd = accept(listen_fd, nullptr, nullptr);
+		if (client_fd < 0) {
+			if (errno == EINTR) continue;
+			std::cerr << "Error accepting connection: " << std::strerror(errno) << std::endl;
+			break;
+		}
+
+		if (not handle_connection(client_fd))
+			stop_requested = 1;
+		close(client_fd);
+	}
+
+	close(listen_fd);
+	unlink(addr.sun_path);
+	return 0;
+}
+
+
+void Daemon::reload_if_stale() {
+	// Pick up edits to config.json without requiring a daemon restart
+	std::error_code ec;
+	if (config) {
+		auto mtime = std::filesystem::last_write_time(config->get_config_path(), ec);
+		if (!ec and mtime == config_mtime)
+			return;
+	}
+
+	handler.reset();
+	db.reset();
+	config = std::make_unique<Config>(config_path);
+	db = std::make_unique<Database>(*config);
+	handler = std::make_unique<Handler>(*db, version);
+	config_mtime = std::filesystem::last_write_time(config->get_config_path(), ec);
+}
+
+
+// Returns false when the daemon should shut down after this request
+bool Daemon::handle_connection(int client_fd) {
+	set_timeout(client_fd, SO_RCVTIMEO, 1);
+	set_timeout(client_fd, SO_SNDTIMEO, 1);
+
+	std::string request;
+	if (not same_user(client_fd) or not read_all(client_fd, request, MAX_REQUEST_SIZE))
+		return true;
+
+	// Split the NUL-terminated fields back into an argv
+	std::vector<std::string> fields;
+	size_t start = 0;
+	for (size_t end = request.find('\0'); end != std::string::npos; end = request.find('\0', start)) {
+		fields.push_back(request.substr(start, end - start));
+		start = end + 1;
+	}
+
+	// A client from a different build must not get answers from this one; step aside so it can start a fresh daemon
+	if (fields.empty() or fields[0] != version) {
+		unsigned char retry = STATUS_RETRY;
+		write_all(client_fd, reinterpret_cast<const char*>(&retry), 1);
+		return false;
+	}
+
+	if (fields.size() < HEADER_FIELDS) {
+		unsigned char retry = STATUS_RETRY;
+		write_all(client_fd, reinterpret_cast<const char*>(&retry), 1);
+		return true;
+	}
+
+	if (fields.size() == HEADER_FIELDS + 2 and fields[HEADER_FIELDS] == "daemon" and fields[HEADER_FIELDS + 1] == "stop") {
+		send_reply(client_fd, 0);
+		return false;
+	}
+
+	// Requests are served one at a time, so a burst of Tabs queues up here. Those a newer completion from the same
+	// terminal has already replaced get the same empty failure they would in-process, without running at all.
+	uint64_t claimed = 0;
+	std::from_chars(fields[3].data(), fields[3].data() + fields[3].size(), claimed);
+	RequestGeneration generation(fields[2], claimed);
+	if (generation.superseded()) {
+		send_reply(client_fd, 1);
+		return true;
+	}
+
+	// Answer from the client's working directory, and go back afterwards so the daemon never keeps one busy. A client
+	// whose directory can't be entered from here answers itself.
+	int own_cwd = open(".", O_RDONLY | O_CLOEXEC);
+	if (chdir(fields[1].c_str()) != 0) {
+		if (own_cwd >= 0)
+			close(own_cwd);
+		unsigned char retry = STATUS_RETRY;
+		write_all(client_fd, reinterpret_cast<const char*>(&retry), 1);
+		return true;
+	}
+
+	std::vector<char*> argv;
+	fields[HEADER_FIELDS - 1] = "dv-binary";
+	for (size_t i = HEADER_FIELDS - 1; i < fields.size(); i++)
+		argv.push_back(fields[i].data());
+
+	// Collect what the handler prints, diagnostics included, so it can be relayed to the client
+	std::ostringstream out, err;
+	std::streambuf* daemon_err = std::cerr.rdbuf(err.rdbuf());
+	reload_if_stale();
+	db->set_abort_check([&generation] { return generation.superseded(); });
+
+	int status = 1;
+	try {
+		status = handler->handle_call(static_cast<int>(argv.size()), argv.data(), out);
+	} catch (const std::exception& e) {
+		std::cerr << "Error handling request: " << e.what() << std::endl;
+	}
+	db->set_abort_check(nullptr);
+	std::cerr.rdbuf(daemon_err);
+	if (own_cwd >= 0) {
+		if (fchdir(own_cwd) != 0)
+			std::cerr << "Error restoring the daemon's working directory: " << std::strerror(errno) << std::endl;
+		close(own_cwd);
+	}
+
+	send_reply(client_fd, status, out.str(), err.str());
+	return true;
+}
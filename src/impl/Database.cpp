@@ -1,10 +1,168 @@
 #include "Database.h"
+#include "utils/Unicode.h"
 
+#include <utility>
 
-Database::Database(const Config& config) : db(config.get_db_path()), config(config), paths_table(*this), shortcuts_table(*this) {
-	// Create the necessary table if it doesn't exist
-	paths_table.create_table();
-	shortcuts_table.create_table();
+
+Database::Database(const Config& config, bool read_only)
+	: read_only(read_only), db(open(config.get_db_path(), this->read_only)), config(config), paths_table(*this), shortcuts_table(*this) {
+	// Only touch the schema when it is missing or out of date, so normal startups never take the write lock
+	if (schema_version() != SCHEMA_VERSION) {
+		if (this->read_only) {
+			this->read_only = false;
+			db = open(config.get_db_path(), this->read_only);
+		}
+		migrate();
+		// A read-only handle only borrows write access for the migration
+		if (read_only) {
+			statements.clear();
+			this->read_only = true;
+			db = open(config.get_db_path(), this->read_only);
+		}
+	}
+}
+
+
+Database::Statement::Statement(Statement&& other) noexcept : stmt(other.stmt), in_use(other.in_use) {
+	other.stmt = nullptr;
+	other.in_use = nullptr;
+}
+
+
+Database::Statement& Database::Statement::operator=(Statement&& other) noexcept {
+	if (this != &other) {
+		release();
+		stmt = std::exchange(other.stmt, nullptr);
+		in_use = std::exchange(other.in_use, nullptr);
+	}
+	return *this;
+}
+
+
+Database::Statement::~Statement() {
+	release();
+}
+
+
+void Database::Statement::release() {
+	if (in_use) {
+		sqlite3_reset(stmt);
+		sqlite3_clear_bindings(stmt);
+		*in_use = false;
+	} else {
+		sqlite3_finalize(stmt);
+	}
+	stmt = nullptr;
+	in_use = nullptr;
+}
+
+
+Database::Statement Database::prepare(const std::string& sql) const {
+	Statement statement;
+	auto it = statements.find(sql);
+	if (it != statements.end() and not it->second.in_use) {
+		statement.stmt = it->second.stmt.get();
+		statement.in_use = &it->second.in_use;
+		it->second.in_use = true;
+		return statement;
+	}
+
+	if (sqlite3_prepare_v2(connection(), sql.c_str(), -1, &statement.stmt, nullptr) != SQLITE_OK) {
+		sqlite3_finalize(statement.stmt);
+		statement.stmt = nullptr;
+		return statement;
+	}
+	if (it == statements.end() and statements.size() < MAX_CACHED_STATEMENTS) {
+		auto& cached = statements.emplace(sql, CachedStatement{ { statement.stmt, sqlite3_finalize }, true }).first->second;
+		statement.in_use = &cached.in_use;
+	}
+	return statement;
+}
+
+
+QueryCache& Database::get_query_cache() {
+	if (not query_cache)
+		query_cache = std::make_unique<QueryCache>(config.get_db_path() + ".results");
+	return *query_cache;
+}
+
+
+void Database::set_abort_check(std::function<bool()> should_abort) {
+	this->should_abort = std::move(should_abort);
+	aborted = false;
+	if (not this->should_abort) {
+		sqlite3_progress_handler(db.connection().get(), 0, nullptr, nullptr);
+		return;
+	}
+
+	sqlite3_progress_handler(db.connection().get(), 1000, [](void* context) {
+		Database* self = static_cast<Database*>(context);
+		if (self->should_abort())
+			self->aborted = true;
+		return self->aborted ? 1 : 0;
+	}, this);
+}
+
+
+sqlite::database Database::open(const std::string& db_path, bool& read_only) {
+	sqlite::sqlite_config sqlite_config;
+	if (read_only) {
+		try {
+			sqlite_config.flags = sqlite::OpenFlags::READONLY;
+			sqlite::database database(db_path, sqlite_config);
+			sqlite3_busy_timeout(database.connection().get(), 2000);
+			return database;
+		} catch (const sqlite::sqlite_exception& e) {
+			// The database doesn't exist yet, so it has to be created read-write
+			read_only = false;
+		}
+	}
+	sqlite::database database(db_path);
+	// Writers (and migrations, when several shells start at once) wait for each other briefly instead of failing
+	// while another process holds the lock
+	sqlite3_busy_timeout(database.connection().get(), 2000);
+	return database;
+}
+
+
+int Database::schema_version() const {
+	int version = 0;
+	try {
+		db << "PRAGMA user_version;" >> version;
+	} catch (const sqlite::sqlite_exception& e) {
+		std::cerr << "Error reading schema version: " << e.what() << std::endl;
+	}
+	return version;
+}
+
+
+void Database::migrate() {
+	// WAL lets completions keep reading while a refresh is writing (persists in the database file)
+	try {
+		db << "PRAGMA journal_mode = WAL;";
+	} catch (const sqlite::sqlite_exception& e) {
+		std::cerr << "Error enabling WAL mode: " << e.what() << std::endl;
+	}
+
+	// The schema is only stamped current together with everything it promises, so a migration that fails (another
+	// shell held the lock too long, say) is rolled back whole and retried on the next open
+	try {
+		db << "BEGIN IMMEDIATE;";
+		// Another process may have finished the same migration while this one waited for the lock
+		if (schema_version() != SCHEMA_VERSION) {
+			paths_table.create_schema();
+			shortcuts_table.create_schema();
+			// Rows written by an older schema are missing from indexes that schema didn't have
+			paths_table.rebuild_indexes();
+			db << "PRAGMA user_version = " + std::to_string(SCHEMA_VERSION) + ";";
+		}
+		db << "COMMIT;";
+	} catch (const sqlite::sqlite_exception& e) {
+		try {
+			db << "ROLLBACK;";
+		} catch (const sqlite::sqlite_exception&) {}
+		std::cerr << "Error migrating database: " << e.what() << std::endl;
+	}
 }
 
 
@@ -66,17 +224,31 @@ bool Database::refresh(const std::string& init_path) {
 	try {
 		db << "BEGIN TRANSACTION;";
 		db << "DROP TABLE IF EXISTS temp_paths;";
-		db << "CREATE TEMP TABLE temp_paths (path TEXT NOT NULL, dir_name TEXT NOT NULL);";
-		auto stmt = db << "INSERT INTO temp_paths (path, dir_name) VALUES (?, ?);";
+		db << "CREATE TEMP TABLE temp_paths (path TEXT NOT NULL, dir_name TEXT NOT NULL, dir_name_folded TEXT NOT NULL, "
+			  "dir_name_reversed TEXT NOT NULL, parent_path TEXT NOT NULL, dir_name_initials TEXT NOT NULL, dir_name_bigrams INTEGER NOT NULL);";
+		auto stmt = db << "INSERT INTO temp_paths (path, dir_name, dir_name_folded, dir_name_reversed, parent_path, dir_name_initials, "
+			  "dir_name_bigrams) VALUES (?, ?, ?, ?, ?, ?, ?);";
 		for (const auto& [path, dir_name] : rows) {
-			stmt << path << dir_name;
+			std::string key = Unicode::match_key(dir_name);
+			stmt << path << dir_name << key << reversed_key(dir_name) << get_parent_path(path) << initialism(dir_name) << bigram_signature(key);
 			stmt++;
 		}
-		db << "INSERT OR IGNORE INTO paths (path, dir_name, last_accessed) SELECT path, dir_name, ? FROM temp_paths;"
+		db << "INSERT OR IGNORE INTO paths (path, dir_name, dir_name_folded, dir_name_reversed, parent_path, dir_name_initials, "
+			  "dir_name_bigrams, last_accessed) "
+			  "SELECT path, dir_name, dir_name_folded, dir_name_reversed, parent_path, dir_name_initials, dir_name_bigrams, ? FROM temp_paths;"
 			 << last_accessed;
-		if (should_delete)
+		int changed = db.rows_modified();
+		if (should_delete) {
 			db << "DELETE FROM paths WHERE path NOT IN (SELECT path FROM temp_paths);";
+			changed += db.rows_modified();
+		}
 		db << "DROP TABLE temp_paths;";
+		// Readers never see the new rows without the lists and statistics built from them. A refresh that found the
+		// same directories (the usual one, at shell start) leaves them, and the generation the query cache relies on, alone.
+		if (changed > 0 or paths_table.generation() == 0) {
+			paths_table.rebuild_components();
+			paths_table.rebuild_stats();
+		}
 		db << "COMMIT;";
 	} catch (const sqlite::sqlite_exception& e) {
 		db << "ROLLBACK;";
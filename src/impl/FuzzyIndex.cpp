@@ -0,0 +1,325 @@
+#include "FuzzyIndex.h"
+
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <queue>
+
+#if defined(__x86_64__) or defined(__i386__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// Scoring constants, the same as fzf's
+static constexpr int SCORE_MATCH = 16;
+static constexpr int SCORE_GAP_START = -3;
+static constexpr int SCORE_GAP_EXTENSION = -1;
+static constexpr int BONUS_BOUNDARY = SCORE_MATCH / 2;
+static constexpr int BONUS_BOUNDARY_WHITE = BONUS_BOUNDARY + 2;
+static constexpr int BONUS_BOUNDARY_DELIMITER = BONUS_BOUNDARY + 1;
+static constexpr int BONUS_NON_WORD = SCORE_MATCH / 2;
+static constexpr int BONUS_CAMEL_123 = BONUS_BOUNDARY + SCORE_GAP_EXTENSION;
+static constexpr int BONUS_CONSECUTIVE = -(SCORE_GAP_START + SCORE_GAP_EXTENSION);
+static constexpr int BONUS_FIRST_CHAR_MULTIPLIER = 2;
+
+// Rows are prefiltered and scored in blocks so an abort check runs every few thousand rows
+static constexpr size_t BLOCK_ROWS = 4096;
+
+enum class CharClass { White, Delimiter, NonWord, Lower, Upper, Number };
+
+static unsigned char fold(unsigned char c) { return c >= 'A' and c <= 'Z' ? c + ('a' - 'A') : c; }
+
+static CharClass char_class(unsigned char c) {
+	if (c >= 'a' and c <= 'z') return CharClass::Lower;
+	if (c >= 'A' and c <= 'Z') return CharClass::Upper;
+	if (c >= '0' and c <= '9') return CharClass::Number;
+	if (c == ' ' or c == '\t') return CharClass::White;
+	if (c == '/' or c == '_' or c == '-' or c == '.' or c == ',' or c == ':' or c == ';' or c == '|') return CharClass::Delimiter;
+	// Bytes of multi-byte UTF-8 characters are treated as letters so they never look like boundaries
+	return c >= 0x80 ? CharClass::Lower : CharClass::NonWord;
+}
+
+static bool is_word(CharClass cls) { return cls == CharClass::Lower or cls == CharClass::Upper or cls == CharClass::Number; }
+
+static int bonus_for(CharClass prev, CharClass cls) {
+	if (is_word(cls)) {
+		if (prev == CharClass::White) return BONUS_BOUNDARY_WHITE;
+		if (prev == CharClass::Delimiter) return BONUS_BOUNDARY_DELIMITER;
+		if (prev == CharClass::NonWord) return BONUS_BOUNDARY;
+		// fooBar and foo123
+		if ((prev == CharClass::Lower and cls == CharClass::Upper) or (prev != CharClass::Number and cls == CharClass::Number))
+			return BONUS_CAMEL_123;
+		return 0;
+	}
+	return BONUS_NON_WORD;
+}
+
+
+std::optional<int> FuzzyIndex::score(std::string_view pattern, std::string_view text) {
+	if (pattern.empty())
+		return 0;
+
+	// Forward pass: the earliest position where the whole pattern has been seen in order
+	size_t p = 0, end = 0;
+	for (size_t i = 0; i < text.size() and p < pattern.size(); i++) {
+		if (fold(text[i]) == fold(pattern[p]) and ++p == pattern.size())
+			end = i + 1;
+	}
+	if (p < pattern.size())
+		return std::nullopt;
+
+	// Backward pass: the latest start that still fits the pattern before `end`, so the window is as tight as possible
+	size_t start = end;
+	p = pattern.size();
+	while (p > 0) {
+		start--;
+		if (fold(text[start]) == fold(pattern[p - 1]))
+			p--;
+	}
+
+	// Score the window, matching greedily from its start
+	int total = 0, first_bonus = 0, consecutive = 0;
+	bool in_gap = false;
+	CharClass prev = start > 0 ? char_class(text[start - 1]) : CharClass::White;
+	p = 0;
+	for (size_t i = start; i < end; i++) {
+		CharClass cls = char_class(text[i]);
+		if (p < pattern.size() and fold(text[i]) == fold(pattern[p])) {
+			total += SCORE_MATCH;
+			int bonus = bonus_for(prev, cls);
+			if (consecutive == 0) {
+				first_bonus = bonus;
+			} else {
+				// A run keeps the bonus of the boundary it started on
+				if (bonus >= BONUS_BOUNDARY and bonus > first_bonus)
+					first_bonus = bonus;
+				bonus = std::max({ bonus, first_bonus, BONUS_CONSECUTIVE });
+			}
+			total += p == 0 ? bonus * BONUS_FIRST_CHAR_MULTIPLIER : bonus;
+			in_gap = false;
+			consecutive++;
+			p++;
+		} else {
+			total += in_gap ? SCORE_GAP_EXTENSION : SCORE_GAP_START;
+			in_gap = true;
+			consecutive = 0;
+			first_bonus = 0;
+		}
+		prev = cls;
+	}
+	return total;
+}
+
+
+uint64_t FuzzyIndex::char_mask(std::string_view text) {
+	uint64_t mask = 0;
+	for (unsigned char c : text) {
+		c = fold(c);
+		if (c >= 'a' and c <= 'z')
+			mask |= 1ULL << (c - 'a');
+		else if (c >= '0' and c <= '9')
+			mask |= 1ULL << (26 + c - '0');
+		else
+			mask |= 1ULL << (36 + c % 28);
+	}
+	return mask;
+}
+
+
+// Prefilter kernels: write the index of every row in [begin, end) whose mask has all the `required` bits to `out`
+using PrefilterKernel = size_t (*)(const uint64_t* masks, size_t begin, size_t end, uint64_t required, uint32_t* out);
+
+static size_t prefilter_scalar(const uint64_t* masks, size_t begin, size_t end, uint64_t required, uint32_t* out) {
+	size_t count = 0;
+	for (size_t i = begin; i < end; i++) {
+		out[count] = static_cast<uint32_t>(i);
+		count += (masks[i] & required) == required;
+	}
+	return count;
+}
+
+#if defined(__x86_64__) or defined(__i386__)
+__attribute__((target("avx2")))
+static size_t prefilter_avx2(const uint64_t* masks, size_t begin, size_t end, uint64_t required, uint32_t* out) {
+	const __m256i want = _mm256_set1_epi64x(static_cast<long long>(required));
+	size_t count = 0, i = begin;
+	for (; i + 4 <= end; i += 4) {
+		__m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(masks + i));
+		__m256i hit = _mm256_cmpeq_epi64(_mm256_and_si256(block, want), want);
+		for (int bits = _mm256_movemask_pd(_mm256_castsi256_pd(hit)); bits; bits &= bits - 1)
+			out[count++] = static_cast<uint32_t>(i + __builtin_ctz(bits));
+	}
+	return count + prefilter_scalar(masks, i, end, required, out + count);
+}
+
+__attribute__((target("sse4.1")))
+static size_t prefilter_sse41(const uint64_t* masks, size_t begin, size_t end, uint64_t required, uint32_t* out) {
+	const __m128i want = _mm_set1_epi64x(static_cast<long long>(required));
+	size_t count = 0, i = begin;
+	for (; i + 2 <= end; i += 2) {
+		__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(masks + i));
+		__m128i hit = _mm_cmpeq_epi64(_mm_and_si128(block, want), want);
+		for (int bits = _mm_movemask_pd(_mm_castsi128_pd(hit)); bits; bits &= bits - 1)
+			out[count++] = static_cast<uint32_t>(i + __builtin_ctz(bits));
+	}
+	return count + prefilter_scalar(masks, i, end, required, out + count);
+}
+#elif defined(__aarch64__)
+static size_t prefilter_neon(const uint64_t* masks, size_t begin, size_t end, uint64_t required, uint32_t* out) {
+	const uint64x2_t want = vdupq_n_u64(required);
+	size_t count = 0, i = begin;
+	for (; i + 2 <= end; i += 2) {
+		uint64x2_t hit = vceqq_u64(vandq_u64(vld1q_u64(masks + i), want), want);
+		out[count] = static_cast<uint32_t>(i);
+		count += vgetq_lane_u64(hit, 0) & 1;
+		out[count] = static_cast<uint32_t>(i + 1);
+		count += vgetq_lane_u64(hit, 1) & 1;
+	}
+	return count + prefilter_scalar(masks, i, end, required, out + count);
+}
+#endif
+
+static PrefilterKernel select_prefilter() {
+#if defined(__x86_64__) or defined(__i386__)
+	if (__builtin_cpu_supports("avx2")) return prefilter_avx2;
+	if (__builtin_cpu_supports("sse4.1")) return prefilter_sse41;
+	return prefilter_scalar;
+#elif defined(__aarch64__)
+	return prefilter_neon;
+#else
+	return prefilter_scalar;
+#endif
+}
+
+
+// Reads a single integer pragma or expression; 0 on error
+static int64_t query_int(sqlite3* connection, const char* sql) {
+	sqlite3_stmt* raw_stmt = nullptr;
+	if (sqlite3_prepare_v2(connection, sql, -1, &raw_stmt, nullptr) != SQLITE_OK)
+		return 0;
+	std::unique_ptr<sqlite3_stmt, decltype(&sqlite3_finalize)> stmt(raw_stmt, sqlite3_finalize);
+	return sqlite3_step(stmt.get()) == SQLITE_ROW ? sqlite3_column_int64(stmt.get(), 0) : 0;
+}
+
+
+void FuzzyIndex::sync(sqlite3* connection) {
+	// data_version moves when another connection commits; total_changes counts this connection's own writes
+	int64_t version = query_int(connection, "PRAGMA data_version;");
+	int64_t changes = sqlite3_total_changes64(connection);
+	if (loaded and version == data_version and changes == total_changes)
+		return;
+
+	load(connection);
+	data_version = version;
+	total_changes = changes;
+}
+
+
+void FuzzyIndex::load(sqlite3* connection) {
+	names.clear();
+	offsets.assign(1, 0);
+	masks.clear();
+	ids.clear();
+	last_accessed.clear();
+	access_counts.clear();
+	loaded = false;
+
+	size_t rows = static_cast<size_t>(query_int(connection, "SELECT COUNT(*) FROM paths;"));
+	offsets.reserve(rows + 1);
+	masks.reserve(rows);
+	ids.reserve(rows);
+	last_accessed.reserve(rows);
+	access_counts.reserve(rows);
+
+	sqlite3_stmt* raw_stmt = nullptr;
+	if (sqlite3_prepare_v2(connection, "SELECT id, dir_name, last_accessed, access_count FROM paths ORDER BY id;", -1, &raw_stmt, nullptr) != SQLITE_OK) {
+		std::cerr << "Error loading fuzzy index: " << sqlite3_errmsg(connection) << std::endl;
+		return;
+	}
+	std::unique_ptr<sqlite3_stmt, decltype(&sqlite3_finalize)> stmt(raw_stmt, sqlite3_finalize);
+
+	while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+		std::string_view dir_name(reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 1)), sqlite3_column_bytes(stmt.get(), 1));
+		names += dir_name;
+		offsets.push_back(static_cast<uint32_t>(names.size()));
+		masks.push_back(char_mask(dir_name));
+		ids.push_back(sqlite3_column_int64(stmt.get(), 0));
+		last_accessed.push_back(sqlite3_column_int64(stmt.get(), 2));
+		access_counts.push_back(sqlite3_column_int64(stmt.get(), 3));
+	}
+	loaded = true;
+}
+
+
+void FuzzyIndex::touch(sqlite3* connection, int64_t id, int64_t accessed, int64_t count) {
+	// Only valid when that UPDATE is the sole change since the last sync; anything else still needs a reload
+	if (not loaded or sqlite3_total_changes64(connection) != total_changes + 1)
+		return;
+
+	auto it = std::lower_bound(ids.begin(), ids.end(), id);
+	if (it == ids.end() or *it != id)
+		return;
+	size_t row = it - ids.begin();
+	last_accessed[row] = accessed;
+	access_counts[row] = count;
+	total_changes++;
+}
+
+
+void FuzzyIndex::skip_changes(sqlite3* connection, int64_t since) {
+	if (loaded and total_changes == since)
+		total_changes = sqlite3_total_changes64(connection);
+}
+
+
+std::vector<FuzzyIndex::Match> FuzzyIndex::top_k(std::string_view pattern, size_t limit, bool by_frequency,
+	const std::function<bool()>& should_abort) const {
+	static const PrefilterKernel prefilter = select_prefilter();
+
+	auto better = [](const Match& a, const Match& b) {
+		if (a.exact != b.exact) return a.exact;
+		if (a.score != b.score) return a.score > b.score;
+		return a.rank > b.rank;
+	};
+	// The worst of the current best `limit` sits on top, so each candidate is one comparison away from being dropped
+	std::priority_queue<Match, std::vector<Match>, decltype(better)> heap(better);
+	if (limit == 0)
+		return {};
+
+	const std::vector<int64_t>& ranks = by_frequency ? access_counts : last_accessed;
+	const uint64_t required = char_mask(pattern);
+	std::vector<uint32_t> candidates(BLOCK_ROWS);
+
+	for (size_t begin = 0; begin < ids.size(); begin += BLOCK_ROWS) {
+		if (should_abort and should_abort())
+			break;
+
+		size_t end = std::min(begin + BLOCK_ROWS, ids.size());
+		size_t count = prefilter(masks.data(), begin, end, required, candidates.data());
+		for (size_t c = 0; c < count; c++) {
+			size_t row = candidates[c];
+			std::string_view text = name(row);
+			std::optional<int> s = score(pattern, text);
+			if (not s)
+				continue;
+
+			Match match = { ids[row], text == pattern, *s, ranks[row] };
+			if (heap.size() < limit) {
+				heap.push(match);
+			} else if (better(match, heap.top())) {
+				heap.pop();
+				heap.push(match);
+			}
+		}
+	}
+
+	std::vector<Match> matches;
+	matches.reserve(heap.size());
+	for (; not heap.empty(); heap.pop())
+		matches.push_back(heap.top());
+	std::reverse(matches.begin(), matches.end());
+	return matches;
+}
@@ -1,5 +1,8 @@
 #include "Handler.h"
+#include "utils/Unicode.h"
 
+#include <algorithm>
+#include <cstdlib>
 #include <fstream>
 #include <filesystem>
 #include <mach-o/dyld.h>
@@ -7,57 +10,201 @@
 
 Handler::Handler(Database& db, const std::string& version) : db(db), version(version) {}
 
-int Handler::handle_tab(int argc, char* argv[]) {
+int Handler::handle_call(int argc, char* argv[], std::ostream& out) {
+	// Need at least 2 arguments: program name and a flag
+	if (argc < 2) {
+		std::cerr << "Usage: " << argv[0] << " [--tab|--enter] dv [command] [path]" << std::endl;
+		return 1;
+	}
+
+	std::string call_type = argv[1];
+
+	// Handle tab completion
+	if (call_type == "--tab" or call_type == "--tab0")
+		return handle_tab(argc, argv, out);
+
+	// Direct subcommand invocation (e.g. `dv-binary init`) — used before the dv() shell function
+	// is available. Synthesize the `--enter dv` prefix so process_args sees the expected structure.
+	std::vector<std::string> wrapped_storage;
+	std::vector<char*> wrapped_argv;
+	int effective_argc = argc;
+	char** effective_argv = argv;
+	if (call_type != "--enter") {
+		wrapped_storage.reserve(argc + 2);
+		wrapped_storage.push_back(argv[0]);
+		wrapped_storage.push_back("--enter");
+		wrapped_storage.push_back("dv");
+		for (int i = 1; i < argc; i++) wrapped_storage.push_back(argv[i]);
+		for (auto& s : wrapped_storage) wrapped_argv.push_back(s.data());
+		effective_argc = wrapped_argv.size();
+		effective_argv = wrapped_argv.data();
+	}
+
+	auto [valid, commands, flags] = ArgParsing::process_args(effective_argc, effective_argv);
+	if (!valid)
+		return 1;
+
+	return handle_enter(commands, flags, out);
+}
+
+int Handler::handle_tab(int argc, char* argv[], std::ostream& out) {
 	// Need at least 4 arguments: dv_binary, --tab, dv, partial_path
 	if (argc < 4) {
 		std::cerr << "Tab completion requires at least a partial path" << std::endl;
 		return 1;
 	}
 
-	
-	
+	// --tab0 separates candidates with NUL instead of newline so any path survives the round trip
+	const char delimiter = std::string_view(argv[1]) == "--tab0" ? '\0' : '\n';
+
 	// Last argument is the partial path
 	std::string partial = argv[argc - 1];
 
+	// The whole response is assembled in one buffer and handed to `out` in a single write
+	std::string buffer;
+
 	// Check if we need to do lazy, in-memory file completion
 	// Our heurisitc is if the last char in the partial path is a '/'
 	if (partial.back() == '/') {
 		// Lazy, in-memory file completion
 		std::vector<std::string> matches = db.get_paths_table().collect_files(partial);
-		for (const auto& match : matches)
-			std::cout << match << std::endl;
+		for (const auto& match : matches) {
+			buffer += match;
+			buffer += delimiter;
+		}
+		out.write(buffer.data(), buffer.size());
 		return 0;
 	}
-	
-	// Get matches for the partial path
-	std::vector<std::string> matches = db.get_paths_table().query(partial);
-	
-	// Check if there are commands/inputs between "dv" and the partial path
-	std::string prefix = "";
-	for (int i = 3; i < argc - 1; i++) {
-		if (i > 3) prefix += " ";
-		prefix += argv[i];
+
+	// Pressing Tab again on the same partial is answered from the query cache until the index changes. Expansions
+	// (~/Co/Pr) read only the index too, but a leading `~` stands for $HOME, so its value is part of the key. Nothing
+	// is cached while the index has no generation (it is being rebuilt).
+	std::vector<std::string> tokens(argv + 3, argv + argc);
+	bool expanding = partial.starts_with('/') or partial.starts_with('~');
+	const Config& config = db.get_config();
+	QueryCache::Key cache_key = { "", config.get_matching_type(), config.get_promotion_strategy(), config.get_max_results(),
+		db.get_paths_table().generation() };
+	const char* home = std::getenv("HOME");
+	if (partial.starts_with('~') and home != nullptr) {
+		cache_key.query += "~=";
+		cache_key.query += home;
+		cache_key.query += '\0';
+	}
+	for (const auto& token : tokens) {
+		cache_key.query += token;
+		cache_key.query += '\0';
+	}
+	// DIRVANA_NO_QUERY_CACHE turns it off, so every completion runs its query (bench_e2e sets it)
+	const bool cacheable = cache_key.generation != 0 and std::getenv("DIRVANA_NO_QUERY_CACHE") == nullptr;
+	std::optional<std::string> cached;
+	if (cacheable and (cached = db.get_query_cache().lookup(cache_key))) {
+		std::replace(cached->begin(), cached->end(), '\0', delimiter);
+		out.write(cached->data(), cached->size());
+		return 0;
 	}
 
-	// Print the matches with appropriate prefixes for zsh completion
-	for (const auto& match : matches)
-		std::cout << match << std::endl;
-	
+	// Rows are copied straight from SQLite into the buffer, sized for a typical full page of results. The cache keeps
+	// them NUL-terminated whatever the delimiter.
+	buffer.reserve(config.get_max_results() * 128);
+	std::string results;
+	auto append = [&](std::string_view match) {
+		buffer += match;
+		buffer += delimiter;
+		results += match;
+		results += '\0';
+	};
+	size_t matched = 0;
+	if (expanding)
+		matched = db.get_paths_table().for_each_expansion(partial, append);
+	// `dv -k proj ap<Tab>` completes paths whose components the words name in order (see handle_enter)
+	else if (tokens.size() > 1 and (tokens[0] == "-k" or tokens[0] == "--keywords"))
+		matched = db.get_paths_table().for_each_keyword_match(std::vector<std::string>(tokens.begin() + 1, tokens.end()), append);
+	if (matched == 0)
+		db.get_paths_table().for_each_match(partial, append);
+
+	// A newer completion request from the same terminal has taken over, so this answer is obsolete
+	if (db.was_aborted())
+		return 1;
+	out.write(buffer.data(), buffer.size());
+	if (cacheable)
+		db.get_query_cache().store(cache_key, results);
+
 	return 0;
 }
 
 
-int Handler::handle_enter(std::vector<std::string>& commands, std::vector<Flag>& flags) {
+bool Handler::is_keyword_query(const std::vector<std::string>& tokens) {
+	if (tokens.size() < 2 or is_command(tokens[0]))
+		return false;
+	for (const auto& token : tokens)
+		if (token.empty() or token == "--" or token.find_first_of("/~") != std::string::npos)
+			return false;
+	return true;
+}
+
+
+int Handler::handle_enter(std::vector<std::string>& commands, std::vector<Flag>& flags, std::ostream& out) {
 	// If --enter was called with no arguments, that is the eqivalent of "cd"
 	// where we want to cd to home dir
 	if (commands.empty() and flags.empty()) {
-		std::cout << "cd ~" << std::endl;
+		out << "cd ~" << '\n';
 		return 0;
 	}
 
 	// Check if a subcommand-less flag was passed (e.g. "--version" ("-v"))
 	if (ArgParsing::has_flag(flags, "version")) {
-		std::cout << "echo Dirvana version " << version << std::endl;
+		out << "echo Dirvana version " << version << '\n';
+		return 0;
+	}
+
+	// How often completions were answered from the query cache, for sizing it
+	if (ArgParsing::has_flag(flags, "cache-stats")) {
+		QueryCache::Stats stats = db.get_query_cache().stats();
+		int64_t lookups = stats.hits + stats.misses;
+		out << "echo \"Query cache: " << stats.entries << "/" << QueryCache::CAPACITY << " entries, " << stats.hits << " hits, "
+			<< stats.misses << " misses (" << (lookups == 0 ? 0 : stats.hits * 100 / lookups) << "% hit rate)\"" << '\n';
+		return 0;
+	}
+
+	// `dv --regex <pattern>` goes to the best directory the pattern matches, whatever the configured matching type
+	if (ArgParsing::has_flag(flags, "regex")) {
+		std::string match;
+		db.get_paths_table().for_each_regex_match(ArgParsing::get_flag_value(flags, "regex"), [&](std::string_view path) {
+			if (match.empty())
+				match = path;
+		});
+		if (match.empty()) {
+			std::cerr << "No directory matches '" << ArgParsing::get_flag_value(flags, "regex") << "'" << std::endl;
+			return 1;
+		}
+		db.get_paths_table().access(match);
+		out << "cd " << match << '\n';
+		return 0;
+	}
+
+	// `dv -k proj api` goes to the best directory whose path has components containing the words in order,
+	// zoxide-style. Tab completion may already have replaced the last word with the full path.
+	if (ArgParsing::has_flag(flags, "keywords")) {
+		std::string match;
+		if (not commands.empty() and commands.back().starts_with('/')) {
+			std::vector<std::string> keywords;
+			for (size_t i = 0; i + 1 < commands.size(); i++)
+				keywords.push_back(Unicode::match_key(commands[i]));
+			keywords.push_back("");
+			if (components_in_order(commands.back(), keywords))
+				match = commands.back();
+		} else {
+			db.get_paths_table().for_each_keyword_match(commands, [&](std::string_view path) {
+				if (match.empty())
+					match = path;
+			});
+		}
+		if (match.empty()) {
+			std::cerr << "No directory matches the keywords" << std::endl;
+			return 1;
+		}
+		db.get_paths_table().access(match);
+		out << "cd " << match << '\n';
 		return 0;
 	}
 
@@ -67,21 +214,21 @@ int Handler::handle_enter(std::vector<std::string>& commands, std::vector<Flag>&
 	// Check if a subcommand was passed
 	if (not bypass) {
 		if (first_token == "build" or first_token == "rebuild")
-			return Subcommands::handle_re_build(*this, commands, flags);
+			return Subcommands::handle_re_build(*this, commands, flags, out);
 		else if (first_token == "refresh")
-			return Subcommands::handle_refresh(*this, commands, flags);
+			return Subcommands::handle_refresh(*this, commands, flags, out);
 		else if (first_token == "install")
-			return Subcommands::handle_install(*this, commands, flags);
+			return Subcommands::handle_install(*this, commands, flags, out);
 		else if (first_token == "init")
-			return Subcommands::handle_init(*this, commands, flags);
+			return Subcommands::handle_init(*this, commands, flags, out);
 		else if (first_token == "add")
-			return Subcommands::handle_add(*this, commands, flags);
+			return Subcommands::handle_add(*this, commands, flags, out);
 		else if (first_token == "delete")
-			return Subcommands::handle_delete(*this, commands, flags);
+			return Subcommands::handle_delete(*this, commands, flags, out);
 		else if (first_token == "list")
-			return Subcommands::handle_list(*this, commands, flags);
+			return Subcommands::handle_list(*this, commands, flags, out);
 		else if (first_token == "show")
-			return Subcommands::handle_show(*this, commands, flags);
+			return Subcommands::handle_show(*this, commands, flags, out);
 	}
 
 	// If we are here, need to handle a shortcut or a path. We prioritize shortcuts over paths
@@ -117,7 +264,7 @@ int Handler::handle_enter(std::vector<std::string>& commands, std::vector<Flag>&
 			command += " " + last_token;
 
 		// Execute the shortcut
-		std::cout << command << std::endl;
+		out << command << '\n';
 
 		// Update the database with the accessed path
 		db.get_shortcuts_table().access(command);
@@ -126,18 +273,46 @@ int Handler::handle_enter(std::vector<std::string>& commands, std::vector<Flag>&
 	}
 
 	// If we are here, we need to handle a path
+
+	// Words with no known command in front (`dv proj api`) may be keywords too. The first word can just as well be an
+	// alias or function only the shell knows about, so they are only read that way when the last word, taken as the
+	// path, matches nothing.
+	std::vector<std::string> path_matches;
+	if (not bypass and is_keyword_query(commands) and commands.back().find('.') == std::string::npos and
+		(path_matches = db.get_paths_table().query(commands.back())).empty()) {
+		std::string match;
+		db.get_paths_table().for_each_keyword_match(commands, [&](std::string_view path) {
+			if (match.empty())
+				match = path;
+		});
+		if (not match.empty()) {
+			db.get_paths_table().access(match);
+			out << "cd " << match << '\n';
+			return 0;
+		}
+	}
 	
 	// Last token (or arg passed to --) is the path to complete
 	std::string path = !commands.empty() ? commands.back() : ArgParsing::get_flag_value(flags, "[bypass]");
+	// An absolute path may abbreviate its segments (~/Co/Pr/di); the index says what it expands to
+	if (path.starts_with('/') or path.starts_with('~')) {
+		std::string best;
+		db.get_paths_table().for_each_expansion(path, [&](std::string_view expansion) {
+			if (best.empty())
+				best = expansion;
+		});
+		if (not best.empty())
+			path = best;
+	}
 	// Check if path is full path or partial
 	if (path.find('/') == std::string::npos and 
 		path.find('~') == std::string::npos and 
 		path.find('.') == std::string::npos) {
 		// Partial path, need to complete
-		std::vector<std::string> matches = db.get_paths_table().query(path);
+		std::vector<std::string> matches = path_matches.empty() ? db.get_paths_table().query(path) : std::move(path_matches);
 		if (matches.empty()) {
 			// 'cd' to the path if no matches found for entries like "~", "..", etc.
-			std::cout << "cd " << path << std::endl;
+			out << "cd " << path << '\n';
 			return 0;
 		}
 		// Use the first match
@@ -162,38 +337,38 @@ int Handler::handle_enter(std::vector<std::string>& commands, std::vector<Flag>&
 	// If no prefix args, just 'cd' to the matched path
 	if (prefix.empty())
 		// No output, just 'cd' to the path
-		std::cout << "cd " << path << std::endl;
+		out << "cd " << path << '\n';
 	else
 		// Execute the output with the path
-		std::cout << prefix << " " << path << std::endl;
+		out << prefix << " " << path << '\n';
 
 	return 0;
 }
 
-int Handler::Subcommands::handle_re_build(Handler& handler, std::vector<std::string>& commands, std::vector<Flag>& flags) {
+int Handler::Subcommands::handle_re_build(Handler& handler, std::vector<std::string>& commands, std::vector<Flag>& flags, std::ostream& out) {
 	// Relevant flags for build/rebuild:
 	std::string init_path = ArgParsing::get_flag_value(flags, "root", handler.get_init_path());
 	bool force = ArgParsing::has_flag(flags, "force");
 				
 	if (handler.db.build(init_path, force)) {
-		std::cout << "echo Build from " << init_path << " complete" << std::endl;
+		out << "echo Build from " << init_path << " complete" << '\n';
 		return 0;
 	} else
 		return 1;
 }
 
-int Handler::Subcommands::handle_refresh(Handler& handler, std::vector<std::string>& commands, std::vector<Flag>& flags) {
+int Handler::Subcommands::handle_refresh(Handler& handler, std::vector<std::string>& commands, std::vector<Flag>& flags, std::ostream& out) {
 	// Relevant flags for refresh:
 	std::string init_path = ArgParsing::get_flag_value(flags, "root", handler.get_init_path());
 
 	if (handler.db.refresh(init_path)) {
-		std::cout << "echo Refresh from " << init_path << " complete" << std::endl;
+		out << "echo Refresh from " << init_path << " complete" << '\n';
 		return 0;
 	} else
 		return 1;
 }
 
-int Handler::Subcommands::handle_install(Handler& handler, std::vector<std::string>& commands, std::vector<Flag>& flags) {
+int Handler::Subcommands::handle_install(Handler& handler, std::vector<std::string>& commands, std::vector<Flag>& flags, std::ostream& out) {
 	// Relevant flags for install:
 	std::string version = ArgParsing::get_flag_value(flags, "version", "latest");
 	if (version == "latest")
@@ -203,8 +378,8 @@ int Handler::Subcommands::handle_install(Handler& handler, std::vector<std::stri
 		"curl -fsSL https://raw.githubusercontent.com/jameskendrick/dirvana/{}/docs/install.sh | bash",
 		version.c_str()
 	);
-	std::cout << "echo Updating Dirvana to version " << version << "..." << std::endl;
-	std::cout << "echo Running: " << curl_command << std::endl;
+	out << "echo Updating Dirvana to version " << version << "..." << '\n';
+	out << "echo Running: " << curl_command << '\n';
 	return 0;
 }
 
@@ -239,7 +414,7 @@ static std::string find_first_on_path(const std::string& name) {
 	return "";
 }
 
-int Handler::Subcommands::handle_init(Handler& handler, std::vector<std::string>& commands, std::vector<Flag>& flags) {
+int Handler::Subcommands::handle_init(Handler& handler, std::vector<std::string>& commands, std::vector<Flag>& flags, std::ostream& out) {
 	const char* home_env = std::getenv("HOME");
 	if (!home_env) {
 		std::cerr << "HOME environment variable not set" << std::endl;
@@ -280,12 +455,18 @@ int Handler::Subcommands::handle_init(Handler& handler, std::vector<std::string>
 
 	std::string completion_file = completions_dir + "/_dv";
 	if (!std::filesystem::exists(completion_file)) {
-		std::ofstream out(completion_file);
-		out << R"(#compdef dv
+		std::ofstream file(completion_file);
+		file << R"(#compdef dv
 
 _dv() {
   local completions
-  completions=("${(@f)$(dv-binary --tab "${words[@]}")}")
+  if (( $+builtins[dv_complete] )); then
+    local -a reply
+    dv_complete "${words[@]}"
+    completions=("${reply[@]}")
+  else
+    completions=("${(@f)$(dv-binary --tab "${words[@]}")}")
+  fi
 
   compadd -S '' -Q -U -V 'Available Options' -- "${completions[@]}"
 }
@@ -310,12 +491,12 @@ _dv() {
 
 	// Prepend the completion block so compinit runs before any later completion config
 	if (!completion_block.empty()) {
-		std::ofstream out(zshrc_path);
-		if (!out.is_open()) {
+		std::ofstream file(zshrc_path);
+		if (!file.is_open()) {
 			std::cerr << "Failed to open " << zshrc_path << std::endl;
 			return 1;
 		}
-		out << completion_block << zshrc_content;
+		file << completion_block << zshrc_content;
 		zshrc_content = completion_block + zshrc_content;
 	}
 
@@ -343,12 +524,12 @@ dv-binary --enter dv refresh &> /dev/null & disown
 	}
 
 	if (!append_block.empty()) {
-		std::ofstream out(zshrc_path, std::ios::app);
-		if (!out.is_open()) {
+		std::ofstream file(zshrc_path, std::ios::app);
+		if (!file.is_open()) {
 			std::cerr << "Failed to open " << zshrc_path << std::endl;
 			return 1;
 		}
-		out << append_block;
+		file << append_block;
 	}
 
 	std::cerr << "Shell configuration written to " << zshrc_path << std::endl;
@@ -362,11 +543,11 @@ dv-binary --enter dv refresh &> /dev/null & disown
 	std::cerr << "Run: source ~/.zshrc" << std::endl;
 
 	// Emit a no-op on stdout so the dv() shell wrapper's eval succeeds silently
-	std::cout << ":" << std::endl;
+	out << ":" << '\n';
 	return 0;
 }
 
-int Handler::Subcommands::handle_add(Handler& handler, std::vector<std::string>& commands, std::vector<Flag>& flags) {
+int Handler::Subcommands::handle_add(Handler& handler, std::vector<std::string>& commands, std::vector<Flag>& flags, std::ostream& out) {
 	// Relevant flags for add:
 	// None for now
 
@@ -386,7 +567,7 @@ int Handler::Subcommands::handle_add(Handler& handler, std::vector<std::string>&
 	// Add the pair to the database
 	handler.db.get_shortcuts_table().add_shortcut(shortcut, command);
 
-	std::cout << "echo Shortcut \"" << shortcut << "\" added for command \"" << command << "\"" << std::endl;
+	out << "echo Shortcut \"" << shortcut << "\" added for command \"" << command << "\"" << '\n';
 
 	return 0;
 }
@@ -396,7 +577,7 @@ const std::string Handler::get_init_path() const {
 }
 
 
-int Handler::Subcommands::handle_delete(Handler& handler, std::vector<std::string>& commands, std::vector<Flag>& flags) {
+int Handler::Subcommands::handle_delete(Handler& handler, std::vector<std::string>& commands, std::vector<Flag>& flags, std::ostream& out) {
 	// Relevant flags for delete:
 	// None for now
 
@@ -411,13 +592,13 @@ int Handler::Subcommands::handle_delete(Handler& handler, std::vector<std::strin
 	// Delete the shortcut from the database
 	handler.db.get_shortcuts_table().delete_shortcut(commands[1]);
 
-	std::cout << "echo Shortcut " << shortcut << " deleted" << std::endl;
+	out << "echo Shortcut " << shortcut << " deleted" << '\n';
 
 	return 0;
 }
 
 
-int Handler::Subcommands::handle_list(Handler& handler, std::vector<std::string>& commands, std::vector<Flag>& flags) {
+int Handler::Subcommands::handle_list(Handler& handler, std::vector<std::string>& commands, std::vector<Flag>& flags, std::ostream& out) {
 	// Relevant flags for list:
 	// None for now
 
@@ -426,13 +607,13 @@ int Handler::Subcommands::handle_list(Handler& handler, std::vector<std::string>
 	std::string output = "Shortcuts:";
 	for (const auto& shortcut : shortcuts)
 		output += "\n" + shortcut;
-	std::cout << "echo \"" << output << "\"" << std::endl;
+	out << "echo \"" << output << "\"" << '\n';
 
 	return 0;
 }
 
 
-int Handler::Subcommands::handle_show(Handler& handler, std::vector<std::string>& commands, std::vector<Flag>& flags) {
+int Handler::Subcommands::handle_show(Handler& handler, std::vector<std::string>& commands, std::vector<Flag>& flags, std::ostream& out) {
 	// Relevant flags for show: none for now
 	
 	if (commands.size() != 2) {
@@ -445,7 +626,7 @@ int Handler::Subcommands::handle_show(Handler& handler, std::vector<std::string>
 	// Show the shortcut from the database
 	std::string command = handler.db.get_shortcuts_table().select_shortcut_command(shortcut);
 	if (not command.empty())
-		std::cout << "echo \"Shortcut: " << shortcut << " | Command: " << command << "\"" << std::endl;
+		out << "echo \"Shortcut: " << shortcut << " | Command: " << command << "\"" << '\n';
 	else {
 		std::cerr << "Shortcut " << shortcut << " not found" << std::endl;
 		return 1;
@@ -0,0 +1,127 @@
+#include "QueryCache.h"
+#include "utils/Helpers.h"
+
+#include <sys/mman.h>
+
+static constexpr size_t HITS = 0, MISSES = 1;
+
+
+QueryCache::QueryCache(const std::string& path) : counters_path(path + "-stats") {
+	try {
+		db = std::make_unique<sqlite::database>(path);
+		// Completions racing each other for the file wait only briefly; losing the cache only costs a few queries
+		sqlite3_busy_timeout(db->connection().get(), 100);
+
+		// Opening an up-to-date cache only reads its header
+		int version = 0;
+		*db << "PRAGMA user_version;" >> version;
+		if (version == SCHEMA_VERSION)
+			return;
+
+		*db << "PRAGMA journal_mode = WAL;";
+		*db << "BEGIN IMMEDIATE;";
+		*db << "DROP TABLE IF EXISTS results;";
+		*db << "DROP TABLE IF EXISTS counters;";
+		*db << "CREATE TABLE results ("
+		"query TEXT NOT NULL, "
+		"matching_type INTEGER NOT NULL, "
+		"strategy INTEGER NOT NULL, "
+		"max_results INTEGER NOT NULL, "
+		"generation INTEGER NOT NULL, "
+		"results BLOB, "
+		"last_used INTEGER NOT NULL, "
+		"PRIMARY KEY (query, matching_type, strategy, max_results)"
+		") WITHOUT ROWID;";
+		*db << "CREATE INDEX idx_results_last_used ON results (last_used);";
+		*db << "PRAGMA user_version = " + std::to_string(SCHEMA_VERSION) + ";";
+		*db << "COMMIT;";
+	} catch (const sqlite::sqlite_exception&) {
+		db.reset();
+	}
+}
+
+
+QueryCache::~QueryCache() {
+	if (counters != nullptr)
+		munmap(counters, 2 * sizeof(uint64_t));
+}
+
+
+void QueryCache::count(size_t counter) {
+	if (counters == nullptr)
+		counters = map_counters(counters_path, 2, true);
+	if (counters != nullptr)
+		__atomic_add_fetch(&counters[counter], 1, __ATOMIC_RELAXED);
+}
+
+
+std::optional<std::string> QueryCache::lookup(const Key& key) {
+	if (not db)
+		return std::nullopt;
+
+	std::optional<std::string> results;
+	try {
+		*db << "SELECT results FROM results WHERE query = ? AND matching_type = ? AND strategy = ? AND max_results = ? AND generation = ?;"
+			<< key.query << static_cast<int>(key.matching_type) << static_cast<int>(key.strategy) << key.max_results << key.generation
+			>> [&](std::vector<char> blob) { results.emplace(blob.begin(), blob.end()); };
+	} catch (const sqlite::sqlite_exception&) {}
+
+	count(results ? HITS : MISSES);
+	if (results and touched.size() < static_cast<size_t>(CAPACITY))
+		touched.push_back(key);
+	return results;
+}
+
+
+void QueryCache::store(const Key& key, const std::string& results) {
+	if (not db)
+		return;
+
+	try {
+		// Nothing here is worth waiting on the disk for
+		if (not writing) {
+			*db << "PRAGMA synchronous = OFF;";
+			writing = true;
+		}
+
+		long long now = Time::now();
+		*db << "BEGIN IMMEDIATE;";
+		for (const auto& hit : touched)
+			*db << "UPDATE results SET last_used = ? WHERE query = ? AND matching_type = ? AND strategy = ? AND max_results = ?;"
+				<< now << hit.query << static_cast<int>(hit.matching_type) << static_cast<int>(hit.strategy) << hit.max_results;
+		*db << "INSERT OR REPLACE INTO results (query, matching_type, strategy, max_results, generation, results, last_used) "
+			"VALUES (?, ?, ?, ?, ?, ?, ?);"
+			<< key.query << static_cast<int>(key.matching_type) << static_cast<int>(key.strategy) << key.max_results << key.generation
+			<< std::vector<char>(results.begin(), results.end()) << now;
+		// Generations only move forward, so entries from an older one can never hit again
+		*db << "DELETE FROM results WHERE generation < ?;" << key.generation;
+		*db << "DELETE FROM results WHERE last_used <= (SELECT last_used FROM results ORDER BY last_used DESC LIMIT 1 OFFSET ?);"
+			<< CAPACITY;
+		*db << "COMMIT;";
+		touched.clear();
+	} catch (const sqlite::sqlite_exception&) {
+		try {
+			*db << "ROLLBACK;";
+		} catch (const sqlite::sqlite_exception&) {}
+	}
+}
+
+
+QueryCache::Stats QueryCache::stats() const {
+	Stats stats;
+	if (not db)
+		return stats;
+
+	try {
+		*db << "SELECT COUNT(*) FROM results;" >> stats.entries;
+	} catch (const sqlite::sqlite_exception& e) {
+		std::cerr << "Error reading query cache statistics: " << e.what() << std::endl;
+	}
+	if (uint64_t* mapped = counters != nullptr ? counters : map_counters(counters_path, 2, false)) {
+		stats.hits = static_cast<int64_t>(__atomic_load_n(&mapped[HITS], __ATOMIC_RELAXED));
+		stats.misses = static_cast<int64_t>(__atomic_load_n(&mapped[MISSES], __ATOMIC_RELAXED));
+		if (mapped != counters)
+			munmap(mapped, 2 * sizeof(uint64_t));
+	}
+	return stats;
+}
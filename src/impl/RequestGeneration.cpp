@@ -0,0 +1,49 @@
+#include "RequestGeneration.h"
+#include "utils/Helpers.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+
+RequestGeneration::RequestGeneration(const std::string& key) : key(key) {
+	if (key.empty())
+		return;
+	counter = map_counters(runtime_path("-tab-" + key + ".seq"), 1, true);
+	if (counter != nullptr)
+		generation = __atomic_add_fetch(counter, 1, __ATOMIC_SEQ_CST);
+}
+
+
+RequestGeneration::RequestGeneration(const std::string& key, uint64_t generation) : key(key), generation(generation) {
+	// Without a counter file nobody on that terminal has claimed anything since
+	if (not key.empty())
+		counter = map_counters(runtime_path("-tab-" + key + ".seq"), 1, false);
+}
+
+
+RequestGeneration::~RequestGeneration() {
+	if (counter != nullptr)
+		munmap(counter, sizeof(uint64_t));
+}
+
+
+bool RequestGeneration::superseded() const {
+	return counter != nullptr and __atomic_load_n(counter, __ATOMIC_RELAXED) != generation;
+}
+
+
+std::string RequestGeneration::tty_key() {
+	// Completion runs inside $(...), so stdout is a pipe but stdin and stderr are still the terminal
+	const char* tty = ttyname(STDIN_FILENO);
+	if (tty == nullptr)
+		tty = ttyname(STDERR_FILENO);
+	if (tty == nullptr)
+		return "";
+
+	std::string key = tty;
+	if (key.starts_with("/dev/"))
+		key.erase(0, 5);
+	for (char& c : key)
+		if (c == '/') c = '_';
+	return key;
+}
@@ -0,0 +1,81 @@
+#include "StdioServer.h"
+
+StdioServer::StdioServer(Handler& handler, bool nul_delimited) : handler(handler), nul_delimited(nul_delimited) {}
+
+
+int StdioServer::serve(std::istream& in, std::ostream& out) {
+	const char delimiter = nul_delimited ? '\0' : '\n';
+
+	std::vector<std::string> words;
+	while (read_request(in, words)) {
+		if (words.empty())
+			continue;
+
+		int status = handle_request(words, out);
+		out << END_MARKER << status << delimiter << std::flush;
+	}
+	return 0;
+}
+
+
+bool StdioServer::read_request(std::istream& in, std::vector<std::string>& words) const {
+	words.clear();
+
+	if (nul_delimited) {
+		std::string word;
+		while (std::getline(in, word, '\0')) {
+			if (word.empty())
+				return true;
+			words.push_back(std::move(word));
+		}
+		// A request cut short by EOF is still answered
+		return not words.empty();
+	}
+
+	std::string line;
+	if (not std::getline(in, line))
+		return false;
+	if (line.empty())
+		return true;
+
+	// Every unescaped space separates two words, so a trailing space means an empty last word (an empty partial)
+	std::string word;
+	for (size_t i = 0; i < line.size(); i++) {
+		if (line[i] == '\\' and i + 1 < line.size())
+			word += line[++i];
+		else if (line[i] == ' ') {
+			words.push_back(std::move(word));
+			word.clear();
+		} else
+			word += line[i];
+	}
+	words.push_back(std::move(word));
+	return true;
+}
+
+
+int StdioServer::handle_request(std::vector<std::string>& words, std::ostream& out) {
+	std::vector<std::string> args = { "dv-binary" };
+	if (words[0] == "tab")
+		args.push_back(nul_delimited ? "--tab0" : "--tab");
+	else if (words[0] == "enter")
+		args.insert(args.end(), { "--enter", "dv" });
+	else {
+		std::cerr << "Unknown request: " << words[0] << std::endl;
+		return 2;
+	}
+	args.insert(args.end(), std::make_move_iterator(words.begin() + 1), std::make_move_iterator(words.end()));
+
+	std::vector<char*> argv;
+	argv.reserve(args.size());
+	for (auto& arg : args)
+		argv.push_back(arg.data());
+
+	// A failing request must not take the whole session down
+	try {
+		return handler.handle_call(static_cast<int>(argv.size()), argv.data(), out);
+	} catch (const std::exception& e) {
+		std::cerr << "Error handling request: " << e.what() << std::endl;
+		return 1;
+	}
+}
@@ -0,0 +1,532 @@
+#include "TrigramQuery.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <set>
+#include <vector>
+
+namespace {
+	// Sets of strings grow by cross products; past this size they are given up on (which only weakens the query)
+	constexpr size_t MAX_SET = 16;
+	// A character class with more members than this matches "any character" as far as the analysis cares
+	constexpr size_t MAX_CLASS = 4;
+
+	using Strings = std::set<std::string>;
+
+	// What the analysis knows about the strings a sub-expression matches: either all of them exactly, or what they
+	// start and end with; plus a query every one of them satisfies
+	struct Info {
+		bool can_be_empty = false;
+		bool exact_known = false;
+		Strings exact;
+		Strings prefix = { "" };
+		Strings suffix = { "" };
+		TrigramQuery match;
+	};
+
+	Strings cross(const Strings& a, const Strings& b) {
+		Strings out;
+		for (const auto& x : a)
+			for (const auto& y : b)
+				out.insert(x + y);
+		return out;
+	}
+
+	Strings merge(Strings a, const Strings& b) {
+		a.insert(b.begin(), b.end());
+		return a;
+	}
+
+	Info exactly(Strings strings) {
+		Info info;
+		info.can_be_empty = strings.contains("");
+		info.exact_known = true;
+		info.exact = std::move(strings);
+		return info;
+	}
+
+	Info any_character() { return Info(); }
+
+	Info any_string() {
+		Info info;
+		info.can_be_empty = true;
+		return info;
+	}
+
+	class Analyzer {
+	public:
+		Analyzer(std::string_view pattern, bool key_domain) : pattern(pattern), key_domain(key_domain) {}
+
+		TrigramQuery run() {
+			Info info = alternation();
+			// A stray ')' ends parsing early; whatever follows it is simply not required
+			return finish(info);
+		}
+
+	private:
+		std::string_view pattern;
+		bool key_domain;
+		size_t i = 0;
+
+		bool at_end() const { return i >= pattern.size(); }
+		char peek() const { return pattern[i]; }
+
+		// A set of strings as a query: one of them must appear. In the key domain an ASCII letter (or '<', '=', '>')
+		// that ends a string may compose with a combining mark that follows it in the text, so it isn't required.
+		TrigramQuery any_of(const Strings& strings) const {
+			TrigramQuery query;
+			bool first = true;
+			for (const auto& s : strings) {
+				std::string required = s;
+				if (key_domain and not required.empty()) {
+					char last = required.back();
+					if ((last >= 'a' and last <= 'z') or last == '<' or last == '=' or last == '>')
+						required.pop_back();
+				}
+				TrigramQuery one = TrigramQuery::of(required);
+				query = first ? one : TrigramQuery::either(std::move(query), std::move(one));
+				first = false;
+				if (query.op == TrigramQuery::Op::All)
+					break;
+			}
+			return query;
+		}
+
+		// Forgets the exact strings, keeping what they imply
+		void make_inexact(Info& info) const {
+			if (not info.exact_known)
+				return;
+			info.match = TrigramQuery::both(std::move(info.match), any_of(info.exact));
+			info.prefix = info.exact;
+			info.suffix = info.exact;
+			info.exact_known = false;
+			info.exact.clear();
+		}
+
+		// Keeps the sets small: long prefixes and suffixes move into the query and are cut to the two characters
+		// that can still combine with a neighbour into a trigram
+		void simplify(Info& info) const {
+			if (info.exact_known and info.exact.size() > MAX_SET)
+				make_inexact(info);
+			if (info.exact_known)
+				return;
+
+			auto trim = [&](Strings& strings, bool keep_front) {
+				if (std::none_of(strings.begin(), strings.end(), [](const std::string& s) { return s.size() > 2; }))
+					return;
+				info.match = TrigramQuery::both(std::move(info.match), any_of(strings));
+				Strings trimmed;
+				for (const auto& s : strings)
+					trimmed.insert(s.size() <= 2 ? s : keep_front ? s.substr(0, 2) : s.substr(s.size() - 2));
+				strings = std::move(trimmed);
+			};
+			trim(info.prefix, true);
+			trim(info.suffix, false);
+			if (info.prefix.size() > MAX_SET)
+				info.prefix = { "" };
+			if (info.suffix.size() > MAX_SET)
+				info.suffix = { "" };
+		}
+
+		TrigramQuery finish(Info& info) const {
+			make_inexact(info);
+			simplify(info);
+			return info.match;
+		}
+
+		Info concat(Info x, Info y) const {
+			if (x.exact_known and y.exact_known and x.exact.size() * y.exact.size() <= MAX_SET) {
+				Info info = exactly(cross(x.exact, y.exact));
+				info.match = TrigramQuery::both(std::move(x.match), std::move(y.match));
+				simplify(info);
+				return info;
+			}
+
+			const Strings& x_suffix = x.exact_known ? x.exact : x.suffix;
+			const Strings& y_prefix = y.exact_known ? y.exact : y.prefix;
+
+			Info info;
+			info.can_be_empty = x.can_be_empty and y.can_be_empty;
+			info.match = TrigramQuery::both(std::move(x.match), std::move(y.match));
+			// Trigrams that straddle the boundary
+			if (x_suffix.size() * y_prefix.size() <= MAX_SET)
+				info.match = TrigramQuery::both(std::move(info.match), any_of(cross(x_suffix, y_prefix)));
+			else
+				info.match = TrigramQuery::both(TrigramQuery::both(std::move(info.match), any_of(x_suffix)), any_of(y_prefix));
+
+			if (x.exact_known)
+				info.prefix = x.exact.size() * y.prefix.size() <= MAX_SET ? cross(x.exact, y.prefix) : x.exact;
+			else
+				info.prefix = x.can_be_empty ? merge(x.prefix, y_prefix) : x.prefix;
+			if (y.exact_known)
+				info.suffix = x.suffix.size() * y.exact.size() <= MAX_SET ? cross(x.suffix, y.exact) : y.exact;
+			else
+				info.suffix = y.can_be_empty ? merge(y.suffix, x_suffix) : y.suffix;
+
+			simplify(info);
+			return info;
+		}
+
+		Info alternate(Info x, Info y) const {
+			if (x.exact_known and y.exact_known and x.exact.size() + y.exact.size() <= MAX_SET) {
+				Info info = exactly(merge(x.exact, y.exact));
+				info.match = TrigramQuery::either(std::move(x.match), std::move(y.match));
+				return info;
+			}
+			make_inexact(x);
+			make_inexact(y);
+
+			Info info;
+			info.can_be_empty = x.can_be_empty or y.can_be_empty;
+			info.prefix = merge(x.prefix, y.prefix);
+			info.suffix = merge(x.suffix, y.suffix);
+			info.match = TrigramQuery::either(std::move(x.match), std::move(y.match));
+			simplify(info);
+			return info;
+		}
+
+		// x+ (and x{n,} with n >= 1) starts like x and ends like x
+		Info one_or_more(Info x) const {
+			make_inexact(x);
+			return x;
+		}
+
+		Info zero_or_one(Info x) const {
+			if (x.exact_known)
+				return exactly(merge(x.exact, { "" }));
+			return any_string();
+		}
+
+		// One character of the text, given as its folded form
+		Info character(char c) const {
+			if (static_cast<unsigned char>(c) >= 0x80)
+				return any_character();
+			if (key_domain and (c == '-' or c == '_' or c == ' '))
+				return exactly({ "" });
+			return exactly({ std::string(1, c >= 'A' and c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c) });
+		}
+
+		Info alternation() {
+			Info info = concatenation();
+			while (not at_end() and peek() == '|') {
+				i++;
+				info = alternate(std::move(info), concatenation());
+			}
+			return info;
+		}
+
+		Info concatenation() {
+			// Runs of exact pieces are joined before anything inexact sees them, so a literal like "test" after ".*"
+			// stays one string instead of being cut into overlapping trigrams one character at a time
+			std::vector<Info> pieces;
+			while (not at_end() and peek() != '|' and peek() != ')') {
+				Info piece = repetition();
+				if (not pieces.empty() and pieces.back().exact_known and piece.exact_known
+					and pieces.back().exact.size() * piece.exact.size() <= MAX_SET)
+					pieces.back() = concat(std::move(pieces.back()), std::move(piece));
+				else
+					pieces.push_back(std::move(piece));
+			}
+
+			Info info = exactly({ "" });
+			for (auto& piece : pieces)
+				info = concat(std::move(info), std::move(piece));
+			return info;
+		}
+
+		Info repetition() {
+			Info info = atom();
+			while (not at_end()) {
+				char c = peek();
+				size_t min = 0, max = 0;
+				if (c == '*') {
+					min = 0, max = SIZE_MAX;
+					i++;
+				} else if (c == '+') {
+					min = 1, max = SIZE_MAX;
+					i++;
+				} else if (c == '?') {
+					min = 0, max = 1;
+					i++;
+				} else if (c != '{' or not bounds(min, max)) {
+					break;
+				}
+				// Lazy quantifiers match the same strings
+				if (not at_end() and peek() == '?')
+					i++;
+
+				if (max == 0)
+					info = exactly({ "" });
+				else if (min >= 1)
+					info = one_or_more(std::move(info));
+				else if (max == 1)
+					info = zero_or_one(std::move(info));
+				else
+					info = any_string();
+			}
+			return info;
+		}
+
+		// {n}, {n,} or {n,m}; anything else is a literal '{'
+		bool bounds(size_t& min, size_t& max) {
+			size_t j = i + 1;
+			auto number = [&](size_t& value) {
+				size_t start = j;
+				value = 0;
+				while (j < pattern.size() and pattern[j] >= '0' and pattern[j] <= '9')
+					value = std::min<size_t>(value * 10 + (pattern[j++] - '0'), 1000000);
+				return j > start;
+			};
+			if (not number(min))
+				return false;
+			max = min;
+			if (j < pattern.size() and pattern[j] == ',') {
+				j++;
+				if (not number(max))
+					max = SIZE_MAX;
+			}
+			if (j >= pattern.size() or pattern[j] != '}')
+				return false;
+			i = j + 1;
+			return true;
+		}
+
+		Info atom() {
+			char c = pattern[i++];
+			switch (c) {
+				case '(': {
+					// Lookarounds constrain the text without consuming it; leaving them out only weakens the query
+					bool assertion = false;
+					if (not at_end() and peek() == '?') {
+						std::string_view rest = pattern.substr(i);
+						assertion = rest.starts_with("?=") or rest.starts_with("?!") or rest.starts_with("?<=") or rest.starts_with("?<!");
+						i += assertion ? (rest[1] == '<' ? 3 : 2) : rest.starts_with("?:") ? 2 : 1;
+					}
+					Info inner = alternation();
+					if (not at_end() and peek() == ')')
+						i++;
+					return assertion ? exactly({ "" }) : inner;
+				}
+				case '[':
+					return character_class();
+				case '.':
+					return any_character();
+				case '^':
+				case '$':
+					return exactly({ "" });
+				case '\\':
+					return escape();
+				default:
+					return character(c);
+			}
+		}
+
+		Info escape() {
+			if (at_end())
+				return character('\\');
+			char c = pattern[i++];
+			switch (c) {
+				case 'b': case 'B':
+					return exactly({ "" });
+				case 'd': case 'D': case 'w': case 'W': case 's': case 'S': case 'u': case 'c': case '0':
+					return any_character();
+				case 'n': return character('\n');
+				case 't': return character('\t');
+				case 'r': return character('\r');
+				case 'f': return character('\f');
+				case 'v': return character('\v');
+				case 'x': {
+					auto hex = [](char h) { return h >= '0' and h <= '9' ? h - '0' : (h | 0x20) >= 'a' and (h | 0x20) <= 'f' ? (h | 0x20) - 'a' + 10 : -1; };
+					if (i + 1 < pattern.size() and hex(pattern[i]) >= 0 and hex(pattern[i + 1]) >= 0) {
+						char value = static_cast<char>(hex(pattern[i]) * 16 + hex(pattern[i + 1]));
+						i += 2;
+						return character(value);
+					}
+					return character('x');
+				}
+				default:
+					// A backreference repeats some earlier text, which may be anything
+					if (c >= '1' and c <= '9') {
+						while (not at_end() and peek() >= '0' and peek() <= '9')
+							i++;
+						return any_string();
+					}
+					return character(c);
+			}
+		}
+
+		Info character_class() {
+			bool negated = not at_end() and peek() == '^';
+			if (negated)
+				i++;
+
+			bool anything = negated;
+			std::set<char> members;
+			auto add_range = [&](unsigned char low, unsigned char high) {
+				if (high < low or high >= 0x80 or static_cast<size_t>(high - low) >= MAX_CLASS * 2) {
+					anything = true;
+					return;
+				}
+				for (unsigned c = low; c <= high; c++)
+					members.insert(static_cast<char>(c));
+			};
+
+			while (not at_end() and peek() != ']') {
+				char c = pattern[i++];
+				if (c == '\\' and not at_end()) {
+					char e = pattern[i++];
+					if (std::string_view("dDwWsSbBucx0").find(e) != std::string_view::npos)
+						anything = true;
+					else
+						c = e == 'n' ? '\n' : e == 't' ? '\t' : e == 'r' ? '\r' : e;
+				} else if (c == '[' and not at_end() and peek() == ':') {
+					// [[:alpha:]] and friends
+					anything = true;
+					size_t end = pattern.find(":]", i);
+					i = end == std::string_view::npos ? pattern.size() : end + 2;
+					continue;
+				}
+				if (i + 1 < pattern.size() and peek() == '-' and pattern[i + 1] != ']') {
+					char high = pattern[i + 1];
+					i += 2;
+					add_range(static_cast<unsigned char>(c), static_cast<unsigned char>(high));
+				} else {
+					add_range(static_cast<unsigned char>(c), static_cast<unsigned char>(c));
+				}
+			}
+			if (not at_end())
+				i++;
+
+			// Folding can merge members ([Aa] is one character), so count what's left after it
+			Strings folded;
+			for (char c : members) {
+				Info one = character(c);
+				if (not one.exact_known)
+					anything = true;
+				else
+					folded.insert(one.exact.begin(), one.exact.end());
+			}
+			if (anything or folded.empty() or folded.size() > MAX_CLASS)
+				return any_character();
+			return exactly(folded);
+		}
+	};
+}
+
+
+// Sorts and dedupes the children of an AND or OR, then drops each literal that `redundant` says another literal
+// makes unnecessary
+static void drop_literals(std::vector<TrigramQuery>& children, bool (*redundant)(const std::string&, const std::string&)) {
+	std::sort(children.begin(), children.end(), [](const TrigramQuery& x, const TrigramQuery& y) { return x.to_fts() < y.to_fts(); });
+	children.erase(std::unique(children.begin(), children.end()), children.end());
+
+	std::vector<bool> drop(children.size(), false);
+	for (size_t k = 0; k < children.size(); k++)
+		for (size_t other = 0; other < children.size() and not drop[k]; other++)
+			drop[k] = other != k and children[k].op == TrigramQuery::Op::Literal and children[other].op == TrigramQuery::Op::Literal
+				and redundant(children[k].literal, children[other].literal);
+
+	std::vector<TrigramQuery> kept;
+	for (size_t k = 0; k < children.size(); k++)
+		if (not drop[k])
+			kept.push_back(std::move(children[k]));
+	children = std::move(kept);
+}
+
+
+TrigramQuery TrigramQuery::from_regex(std::string_view pattern, bool key_domain) {
+	return Analyzer(pattern, key_domain).run();
+}
+
+
+TrigramQuery TrigramQuery::of(std::string literal) {
+	TrigramQuery query;
+	if (literal.size() >= 3) {
+		query.op = Op::Literal;
+		query.literal = std::move(literal);
+	}
+	return query;
+}
+
+
+TrigramQuery TrigramQuery::both(TrigramQuery a, TrigramQuery b) {
+	if (a.op == Op::All)
+		return b;
+	if (b.op == Op::All or a == b)
+		return a;
+
+	TrigramQuery query;
+	query.op = Op::And;
+	for (auto* side : { &a, &b }) {
+		if (side->op == Op::And)
+			for (auto& child : side->children)
+				query.children.push_back(std::move(child));
+		else
+			query.children.push_back(std::move(*side));
+	}
+	// A literal inside another one is implied by it
+	drop_literals(query.children, [](const std::string& kept, const std::string& other) { return other.find(kept) != std::string::npos; });
+	return query.children.size() == 1 ? query.children[0] : query;
+}
+
+
+TrigramQuery TrigramQuery::either(TrigramQuery a, TrigramQuery b) {
+	if (a.op == Op::All or b.op == Op::All)
+		return all();
+	if (a == b)
+		return a;
+
+	TrigramQuery query;
+	query.op = Op::Or;
+	for (auto* side : { &a, &b }) {
+		if (side->op == Op::Or)
+			for (auto& child : side->children)
+				query.children.push_back(std::move(child));
+		else
+			query.children.push_back(std::move(*side));
+	}
+	// A literal containing another one adds nothing to the alternatives
+	drop_literals(query.children, [](const std::string& kept, const std::string& other) { return kept.find(other) != std::string::npos; });
+	return query.children.size() == 1 ? query.children[0] : query;
+}
+
+
+std::string TrigramQuery::to_fts() const {
+	switch (op) {
+		case Op::All:
+			return "";
+		case Op::Literal: {
+			std::string phrase = "\"";
+			for (char c : literal)
+				phrase += c == '"' ? "\"\"" : std::string(1, c);
+			return phrase + "\"";
+		}
+		case Op::And:
+		case Op::Or: {
+			std::string expression = "(";
+			for (size_t k = 0; k < children.size(); k++)
+				expression += (k == 0 ? "" : op == Op::And ? " AND " : " OR ") + children[k].to_fts();
+			return expression + ")";
+		}
+	}
+	return "";
+}
+
+
+std::string TrigramQuery::to_sql(const std::string& column, std::vector<std::string>& binds) const {
+	switch (op) {
+		case Op::All:
+			return "";
+		case Op::Literal:
+			binds.push_back(literal);
+			return "instr(lower(" + column + "), ?) > 0";
+		case Op::And:
+		case Op::Or: {
+			std::string condition = "(";
+			for (size_t k = 0; k < children.size(); k++)
+				condition += (k == 0 ? "" : op == Op::And ? " AND " : " OR ") + children[k].to_sql(column, binds);
+			return condition + ")";
+		}
+	}
+	return "";
+}
@@ -1,24 +1,30 @@
 #include "tables/Paths.h"
 #include "Database.h"
+#include "TrigramQuery.h"
 #include "utils/Helpers.h"
+#include "utils/Unicode.h"
 
+#include <algorithm>
+#include <cstdlib>
 #include <future>
+#include <iterator>
+#include <regex>
+#include <unordered_map>
+
+// Columns computed from dir_name when a row is written (see bulk_insert and Database::refresh)
+static constexpr std::pair<const char*, const char*> DERIVED_COLUMNS[] = {
+	{ "dir_name_folded", "TEXT NOT NULL DEFAULT ''" },
+	{ "dir_name_reversed", "TEXT NOT NULL DEFAULT ''" },
+	{ "parent_path", "TEXT NOT NULL DEFAULT ''" },
+	{ "dir_name_initials", "TEXT NOT NULL DEFAULT ''" },
+	{ "dir_name_bigrams", "INTEGER NOT NULL DEFAULT 0" },
+};
+
 
 void PathsTable::create_table() const {
 	try {
 		db << "BEGIN TRANSACTION;";
-		
-		db << "CREATE TABLE IF NOT EXISTS paths ("
-		"id INTEGER PRIMARY KEY AUTOINCREMENT, "
-		"path TEXT NOT NULL, "
-		"dir_name TEXT NOT NULL, "
-		"last_accessed INTEGER NOT NULL, "
-		"access_count INTEGER NOT NULL DEFAULT 0"
-		");";
-		db << "CREATE UNIQUE INDEX IF NOT EXISTS idx_path ON paths (path);";
-		db << "CREATE INDEX IF NOT EXISTS idx_paths_dir_recency ON paths (dir_name, last_accessed DESC);";
-		db << "CREATE INDEX IF NOT EXISTS idx_paths_dir_freq ON paths (dir_name, access_count DESC);";
-		
+		create_schema();
 		db << "COMMIT;";
 	} catch (const sqlite::sqlite_exception& e) {
 		db << "ROLLBACK;";
@@ -27,49 +33,940 @@ void PathsTable::create_table() const {
 }
 
 
+void PathsTable::create_schema() const {
+	db << "CREATE TABLE IF NOT EXISTS paths ("
+	"id INTEGER PRIMARY KEY AUTOINCREMENT, "
+	"path TEXT NOT NULL, "
+	"dir_name TEXT NOT NULL, "
+	"last_accessed INTEGER NOT NULL, "
+	"access_count INTEGER NOT NULL DEFAULT 0"
+	");";
+
+	// Derived lookup keys are added in place on databases created before they existed; rebuild_indexes() fills them in
+	for (const auto& [column, definition] : DERIVED_COLUMNS) {
+		int exists = 0;
+		db << "SELECT COUNT(*) FROM pragma_table_info('paths') WHERE name = ?;" << column >> exists;
+		if (not exists)
+			db << "ALTER TABLE paths ADD COLUMN " + std::string(column) + " " + definition + ";";
+	}
+
+	db << "CREATE UNIQUE INDEX IF NOT EXISTS idx_path ON paths (path);";
+	db << "CREATE INDEX IF NOT EXISTS idx_paths_dir_recency ON paths (dir_name, last_accessed DESC);";
+	db << "CREATE INDEX IF NOT EXISTS idx_paths_dir_freq ON paths (dir_name, access_count DESC);";
+	// Names are matched through their match keys (see Unicode::match_key): exact and prefix queries become lookups
+	// and range scans over the key, suffix queries range scans over its reverse.
+	db << "CREATE INDEX IF NOT EXISTS idx_paths_folded ON paths (dir_name_folded);";
+	// Abbreviated paths expand one segment at a time: children of a parent by name prefix
+	db << "CREATE INDEX IF NOT EXISTS idx_paths_parent ON paths (parent_path, dir_name_folded);";
+	db << "CREATE INDEX IF NOT EXISTS idx_paths_reversed ON paths (dir_name_reversed);";
+	// Initialisms (pga for payment-gateway-adapter) are looked up whole
+	db << "CREATE INDEX IF NOT EXISTS idx_paths_initials ON paths (dir_name_initials);";
+	// Unselective short queries walk the rows best first and stop at max_results instead of sorting every match
+	db << "CREATE INDEX IF NOT EXISTS idx_paths_recency ON paths (last_accessed);";
+	db << "CREATE INDEX IF NOT EXISTS idx_paths_frequency ON paths (access_count);";
+
+	// Trigram index over the match key so contains queries don't scan every row. It is an external-content table
+	// kept in sync by triggers, so bulk_insert, refresh and delete_paths all maintain it without extra code.
+	// Older schemas indexed dir_name itself; that table is replaced and rebuild_indexes() refills it.
+	std::string trigram_sql;
+	db << "SELECT COALESCE(MAX(sql), '') FROM sqlite_master WHERE name = 'paths_trigram';" >> trigram_sql;
+	if (not trigram_sql.empty() and trigram_sql.find("dir_name_folded") == std::string::npos) {
+		db << "DROP TRIGGER IF EXISTS paths_trigram_insert;";
+		db << "DROP TRIGGER IF EXISTS paths_trigram_delete;";
+		db << "DROP TRIGGER IF EXISTS paths_trigram_update;";
+		db << "DROP TABLE paths_trigram;";
+	}
+	db << "CREATE VIRTUAL TABLE IF NOT EXISTS paths_trigram USING fts5("
+	"dir_name_folded, content='paths', content_rowid='id', tokenize='trigram'"
+	");";
+	db << "CREATE TRIGGER IF NOT EXISTS paths_trigram_insert AFTER INSERT ON paths BEGIN "
+	"INSERT INTO paths_trigram (rowid, dir_name_folded) VALUES (new.id, new.dir_name_folded); "
+	"END;";
+	db << "CREATE TRIGGER IF NOT EXISTS paths_trigram_delete AFTER DELETE ON paths BEGIN "
+	"INSERT INTO paths_trigram (paths_trigram, rowid, dir_name_folded) VALUES ('delete', old.id, old.dir_name_folded); "
+	"END;";
+	// The key only changes along with dir_name, except in rebuild_indexes(), which rebuilds the whole table anyway
+	db << "CREATE TRIGGER IF NOT EXISTS paths_trigram_update AFTER UPDATE OF dir_name ON paths BEGIN "
+	"INSERT INTO paths_trigram (paths_trigram, rowid, dir_name_folded) VALUES ('delete', old.id, old.dir_name_folded); "
+	"INSERT INTO paths_trigram (rowid, dir_name_folded) VALUES (new.id, new.dir_name_folded); "
+	"END;";
+
+	// Inverted index from each folded path component to the ids of every path that goes through it, for
+	// multi-keyword queries. Posting lists are delta/varint encoded (see Postings) and rebuilt by rebuild_components().
+	db << "CREATE TABLE IF NOT EXISTS path_components ("
+	"component TEXT PRIMARY KEY, "
+	"postings BLOB NOT NULL"
+	") WITHOUT ROWID;";
+
+	// How many names contain each byte and byte pair of their key, or start or end with one or two bytes, for
+	// the query planner in for_each_match. Rebuilt by rebuild_stats().
+	db << "CREATE TABLE IF NOT EXISTS match_stats ("
+	"gram BLOB PRIMARY KEY, "
+	"names INTEGER NOT NULL"
+	") WITHOUT ROWID;";
+	// The best max_results rows for each of those grams under each promotion strategy, so one- and two-byte queries
+	// (which match most of the index) read a short list instead of ranking every match. access() keeps them current.
+	db << "CREATE TABLE IF NOT EXISTS top_matches ("
+	"gram BLOB NOT NULL, "
+	"strategy INTEGER NOT NULL, "
+	"id INTEGER NOT NULL, "
+	"rank INTEGER NOT NULL, "
+	"PRIMARY KEY (gram, strategy, id)"
+	") WITHOUT ROWID;";
+
+	// The index's generation, which every write moves forward, so cached query results know when they went stale.
+	// It outlives drop_table() and starts from the clock, so a rebuilt index never reuses an old generation.
+	db << "CREATE TABLE IF NOT EXISTS meta ("
+	"name TEXT PRIMARY KEY, "
+	"value INTEGER NOT NULL"
+	") WITHOUT ROWID;";
+}
+
+
 void PathsTable::drop_table() const {
+	// The triggers go away with paths itself
+	db << "DROP TABLE IF EXISTS path_components;";
+	db << "DROP TABLE IF EXISTS match_stats;";
+	db << "DROP TABLE IF EXISTS top_matches;";
+	db << "DROP TABLE IF EXISTS paths_trigram;";
 	db << "DROP TABLE IF EXISTS paths;";
 }
 
 
-std::vector<std::string> PathsTable::query(const std::string& input) const {
-	std::string dir_name = get_dir_name(input);
-	std::vector<std::string> path_rankings;
-	const std::string sort_col = db.get_config().get_promotion_strategy() == PromotionStrategy::RECENTLY_ACCESSED
-		? "last_accessed" : "access_count";
-	const int max_results = db.get_config().get_max_results();
+void PathsTable::rebuild_indexes() const {
+	// Read everything first so the rows aren't rewritten underneath the running SELECT
+	std::vector<std::tuple<long long, std::string, std::string>> rows;
+	db << "SELECT id, path, dir_name FROM paths;" >> [&](long long id, std::string path, std::string dir_name) {
+		rows.emplace_back(id, std::move(path), std::move(dir_name));
+	};
+
+	auto stmt = db << "UPDATE paths SET dir_name_folded = ?, dir_name_reversed = ?, parent_path = ?, dir_name_initials = ?, "
+		"dir_name_bigrams = ? WHERE id = ?;";
+	for (const auto& [id, path, dir_name] : rows) {
+		std::string key = Unicode::match_key(dir_name);
+		stmt << key << reversed_key(dir_name) << get_parent_path(path) << initialism(dir_name) << bigram_signature(key) << id;
+		stmt++;
+	}
+	db << "INSERT INTO paths_trigram (paths_trigram) VALUES ('rebuild');";
+	rebuild_components();
+	rebuild_stats();
+}
+
+
+void PathsTable::rebuild_components() const {
+	// Ids are read in ascending order, so every posting list comes out sorted without another pass
+	std::unordered_map<std::string, std::vector<int64_t>> postings;
+	db << "SELECT id, path FROM paths ORDER BY id;" >> [&](long long id, std::string path) {
+		size_t start = 0;
+		while (start < path.size()) {
+			size_t end = path.find('/', start);
+			if (end == std::string::npos)
+				end = path.size();
+			// Components are keyed like names (see Unicode::match_key); one of separators only has no key
+			std::string key = end > start ? Unicode::match_key(std::string_view(path).substr(start, end - start)) : "";
+			if (not key.empty()) {
+				auto& ids = postings[key];
+				if (ids.empty() or ids.back() != id)
+					ids.push_back(id);
+			}
+			start = end + 1;
+		}
+	};
 
+	db << "DELETE FROM path_components;";
+	if (not postings.empty()) {
+		auto stmt = db << "INSERT INTO path_components (component, postings) VALUES (?, ?);";
+		for (const auto& [component, ids] : postings) {
+			std::string encoded = Postings::encode(ids);
+			stmt << component << std::vector<char>(encoded.begin(), encoded.end());
+			stmt++;
+		}
+	}
+}
+
+
+void PathsTable::bump_generation() const {
+	db << "INSERT INTO meta (name, value) VALUES ('generation', ?) ON CONFLICT DO UPDATE SET value = MAX(value + 1, excluded.value);"
+		<< Time::now();
+}
+
+
+int64_t PathsTable::generation() const {
+	long long generation = 0;
 	try {
-		if (db.get_config().get_matching_type() == MatchingType::Exact) {
-			db << "SELECT path FROM paths WHERE dir_name = ? ORDER BY " + sort_col + " DESC LIMIT ?;"
-			   << dir_name << max_results
-			   >> [&](std::string path) { path_rankings.push_back(path); };
-		} else {
-			// Single query: exact matches sort first (rank 0), fuzzy matches second (rank 1).
-			// Each path row appears at most once, so no dedup set is needed.
-			std::string like_pattern = get_query_pattern(dir_name);
-			db << "SELECT path FROM paths WHERE dir_name = ? OR dir_name LIKE ? "
-			      "ORDER BY CASE WHEN dir_name = ? THEN 0 ELSE 1 END ASC, " + sort_col + " DESC LIMIT ?;"
-			   << dir_name << like_pattern << dir_name << max_results
-			   >> [&](std::string path) { path_rankings.push_back(path); };
+		// An index without statistics is mid-rebuild (or failed one), and results computed from it mustn't outlive it
+		db << "SELECT COALESCE(MAX(value), 0) * EXISTS (SELECT 1 FROM match_stats WHERE gram = X'23') FROM meta "
+			"WHERE name = 'generation';" >> generation;
+	} catch (const sqlite::sqlite_exception& e) {
+		std::cerr << "Error reading index generation: " << e.what() << std::endl;
+	}
+	return generation;
+}
+
+
+// match_stats and top_matches are keyed by one- and two-byte grams of the keys; each kind of gram gets GRAM_SLOTS counters
+static constexpr size_t GRAM_SLOTS = 256 + 65536;
+static constexpr char STATS_KINDS[] = { '*', '^', '$' };	// contained in, starts, ends the key
+
+static size_t gram_slot(std::string_view gram) {
+	auto byte = [&](size_t i) { return static_cast<size_t>(static_cast<unsigned char>(gram[i])); };
+	return gram.size() == 1 ? byte(0) : 256 + (byte(0) << 8 | byte(1));
+}
+
+// Calls visit with the counter of every gram of `key`; a gram repeated within the key comes up more than once
+template <typename Visit>
+static void for_each_gram(std::string_view key, const Visit& visit) {
+	for (size_t length = 1; length <= 2 and length <= key.size(); length++) {
+		for (size_t i = 0; i + length <= key.size(); i++)
+			visit(gram_slot(key.substr(i, length)));
+		visit(GRAM_SLOTS + gram_slot(key.substr(0, length)));
+		visit(2 * GRAM_SLOTS + gram_slot(key.substr(key.size() - length)));
+	}
+}
+
+// The stored form of a counter's gram: its kind followed by its bytes
+static std::vector<char> gram_blob(size_t counter) {
+	std::vector<char> gram = { STATS_KINDS[counter / GRAM_SLOTS] };
+	size_t slot = counter % GRAM_SLOTS;
+	if (slot < 256) {
+		gram.push_back(static_cast<char>(slot));
+	} else {
+		gram.push_back(static_cast<char>((slot - 256) >> 8));
+		gram.push_back(static_cast<char>((slot - 256) & 0xFF));
+	}
+	return gram;
+}
+
+static std::string sort_column(PromotionStrategy strategy) {
+	return strategy == PromotionStrategy::RECENTLY_ACCESSED ? "last_accessed" : "access_count";
+}
+
+
+void PathsTable::rebuild_stats() const {
+	const size_t top_k = static_cast<size_t>(std::max(db.get_config().get_max_results(), 0));
+	std::vector<int64_t> counts(std::size(STATS_KINDS) * GRAM_SLOTS);
+	// The row each gram was last seen in (so a repeated gram counts once), and how long its top list is so far
+	std::vector<int64_t> seen_in(counts.size());
+	std::vector<size_t> listed(counts.size());
+	struct Listing { size_t counter; PromotionStrategy strategy; int64_t id; int64_t rank; };
+	std::vector<Listing> listings;
+	int64_t names = 0;
+
+	// Rows come best first in each promotion order, so a gram's top list is just the first top_k rows that have it
+	for (PromotionStrategy strategy : { PromotionStrategy::RECENTLY_ACCESSED, PromotionStrategy::FREQUENCY_BASED }) {
+		const bool counting = strategy == PromotionStrategy::RECENTLY_ACCESSED;
+		const std::string sort_col = sort_column(strategy);
+		std::fill(seen_in.begin(), seen_in.end(), -1);
+		std::fill(listed.begin(), listed.end(), 0);
+
+		const std::string sql = "SELECT id, dir_name_folded, " + sort_col + " FROM paths ORDER BY " + sort_col + " DESC;";
+		auto stmt = db.prepare(sql);
+		if (not stmt)
+			sqlite::errors::throw_sqlite_error(sqlite3_errcode(db.connection()), sql, sqlite3_errmsg(db.connection()));
+		int64_t row = 0;
+		int rc;
+		while ((rc = sqlite3_step(stmt.get())) == SQLITE_ROW) {
+			int64_t id = sqlite3_column_int64(stmt.get(), 0);
+			std::string_view key(reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 1)), sqlite3_column_bytes(stmt.get(), 1));
+			int64_t rank = sqlite3_column_int64(stmt.get(), 2);
+			for_each_gram(key, [&](size_t counter) {
+				if (seen_in[counter] == row)
+					return;
+				seen_in[counter] = row;
+				if (counting)
+					counts[counter]++;
+				if (listed[counter] < top_k) {
+					listed[counter]++;
+					listings.push_back({ counter, strategy, id, rank });
+				}
+			});
+			row++;
 		}
+		if (rc != SQLITE_DONE)
+			sqlite::errors::throw_sqlite_error(rc, sql, sqlite3_errmsg(db.connection()));
+		if (counting)
+			names = row;
+	}
+
+	db << "DELETE FROM match_stats;";
+	db << "DELETE FROM top_matches;";
+	// The total is stored under a gram of its own
+	auto stmt = db << "INSERT INTO match_stats (gram, names) VALUES (?, ?);";
+	stmt << std::vector<char>{ '#' } << names;
+	stmt++;
+	for (size_t counter = 0; counter < counts.size(); counter++) {
+		if (counts[counter] == 0)
+			continue;
+		stmt << gram_blob(counter) << counts[counter];
+		stmt++;
+	}
+	if (not listings.empty()) {
+		auto insert = db << "INSERT INTO top_matches (gram, strategy, id, rank) VALUES (?, ?, ?, ?);";
+		for (const auto& listing : listings) {
+			insert << gram_blob(listing.counter) << static_cast<int>(listing.strategy) << listing.id << listing.rank;
+			insert++;
+		}
+	}
+
+	// Gives SQLite's own planner index statistics (sqlite_stat1) too, sampled so it stays cheap on big tables
+	try {
+		db << "PRAGMA analysis_limit = 1000;";
+		db << "ANALYZE paths;";
 	} catch (const sqlite::sqlite_exception& e) {
-		std::cerr << "Error querying database: " << e.what() << std::endl;
+		std::cerr << "Error analyzing paths: " << e.what() << std::endl;
+	}
+
+	// Everything derived from the rows is current again, in the same commit
+	bump_generation();
+}
+
+
+bool PathsTable::serves_top_matches(const std::string& gram, PromotionStrategy strategy, size_t limit) const {
+	auto stmt = db.prepare("SELECT (SELECT COUNT(*) FROM top_matches WHERE gram = ?1 AND strategy = ?2), "
+		"COALESCE((SELECT names FROM match_stats WHERE gram = ?1), 0), "
+		"EXISTS (SELECT 1 FROM match_stats WHERE gram = X'23');");
+	if (not stmt)
+		return false;
+	sqlite3_bind_blob(stmt.get(), 1, gram.data(), gram.size(), SQLITE_STATIC);
+	sqlite3_bind_int(stmt.get(), 2, static_cast<int>(strategy));
+	// Without the total row the lists were never built, and empty lists would prove nothing
+	if (sqlite3_step(stmt.get()) != SQLITE_ROW or sqlite3_column_int(stmt.get(), 2) == 0)
+		return false;
+	// A list shorter than the limit still works when it has every match
+	int64_t listed = sqlite3_column_int64(stmt.get(), 0);
+	return listed >= static_cast<int64_t>(limit) or listed == sqlite3_column_int64(stmt.get(), 1);
+}
+
+
+bool PathsTable::estimate_matches(MatchingType type, const std::string& key, int64_t& matches, int64_t& names) const {
+	auto stmt = db.prepare("SELECT names FROM match_stats WHERE gram = ?;");
+	if (not stmt or key.empty())
+		return false;
+	auto lookup = [&](char kind, std::string_view gram) -> int64_t {
+		std::string blob = kind + std::string(gram);
+		sqlite3_bind_blob(stmt.get(), 1, blob.data(), blob.size(), SQLITE_STATIC);
+		int64_t count = sqlite3_step(stmt.get()) == SQLITE_ROW ? sqlite3_column_int64(stmt.get(), 0) : -1;
+		sqlite3_reset(stmt.get());
+		return count;
+	};
+
+	names = lookup('#', "");
+	if (names < 0)
+		return false;
+	// Grams nobody has aren't stored
+	if (type == MatchingType::Prefix) {
+		matches = lookup('^', std::string_view(key).substr(0, 2));
+	} else if (type == MatchingType::Suffix) {
+		matches = lookup('$', std::string_view(key).substr(key.size() - std::min<size_t>(key.size(), 2)));
+	} else {
+		// A name containing the key contains each of its bigrams, so the rarest one bounds the matches
+		matches = key.size() == 1 ? lookup('*', key) : names;
+		for (size_t i = 0; i + 2 <= key.size() and matches > 0; i++)
+			matches = std::min(matches, std::max<int64_t>(lookup('*', std::string_view(key).substr(i, 2)), 0));
+	}
+	matches = std::max<int64_t>(matches, 0);
+	return true;
+}
+
+
+// FTS5 query for a contains key: the key as one quoted phrase. Returns "" when it is shorter than a trigram,
+// and the caller falls back to a scan.
+static std::string trigram_match_expression(const std::string& key) {
+	std::string phrase = "\"";
+	size_t characters = 0;
+	for (char c : key) {
+		phrase += c == '"' ? "\"\"" : std::string(1, c);
+		// Trigrams are counted in characters, so UTF-8 continuation bytes don't count
+		if ((static_cast<unsigned char>(c) & 0xC0) != 0x80)
+			characters++;
 	}
+	return characters >= 3 ? phrase + "\"" : "";
+}
 
+
+std::vector<std::string> PathsTable::query(const std::string& input) const {
+	std::vector<std::string> path_rankings;
+	for_each_match(input, [&](std::string_view path) { path_rankings.emplace_back(path); });
 	return path_rankings;
 }
 
 
-void PathsTable::access(const std::string& path) {
+size_t PathsTable::for_each_match(const std::string& input, const std::function<void(std::string_view)>& visit) const {
+	std::string dir_name = get_dir_name(input);
+	const std::string sort_col = sort_column(db.get_config().get_promotion_strategy());
+	const size_t max_results = static_cast<size_t>(std::max(db.get_config().get_max_results(), 0));
+	const MatchingType matching_type = db.get_config().get_matching_type();
+	const bool exact = matching_type == MatchingType::Exact;
+	if (matching_type == MatchingType::Fuzzy)
+		return for_each_fuzzy_match(dir_name, visit);
+	if (matching_type == MatchingType::Regex)
+		return for_each_regex_match(input, visit);
+
+	// Names match through their keys, so case, composition and separators don't matter: "my-service" finds
+	// My_Service. A needle with no key characters (only separators) falls back to matching dir_name itself.
+	const std::string key = Unicode::match_key(dir_name);
+	std::string like_pattern = get_query_pattern(dir_name);
+	std::string trigram_query, range_low, range_high, top_gram;
+	std::function<bool(std::string_view)> key_matches;
+	std::string where;
+	if (exact) {
+		key_matches = [&](std::string_view name) { return name == key; };
+	} else if (matching_type == MatchingType::Prefix) {
+		// Prefix and suffix queries scan the range of keys (or reversed keys) that start with the needle's own
+		range_low = key;
+		where = "dir_name_folded >= ?5";
+		key_matches = [&](std::string_view name) { return name.starts_with(key); };
+	} else if (matching_type == MatchingType::Suffix) {
+		range_low = reversed_key(dir_name);
+		where = "dir_name_reversed >= ?5";
+		key_matches = [&](std::string_view name) { return name.ends_with(key); };
+	} else {
+		// Contains queries are answered from the trigram index once the key is a trigram long, with instr as the filter.
+		// Shorter keys scan, but rows missing one of the key's bigrams are dropped by an integer test before instr runs.
+		trigram_query = trigram_match_expression(key);
+		where = (trigram_query.empty() ? "(dir_name_bigrams & ?8) = ?8 AND " : "id IN (SELECT rowid FROM paths_trigram WHERE paths_trigram MATCH ?4) AND ")
+			+ std::string("instr(dir_name_folded, ?7) > 0");
+		key_matches = [&](std::string_view name) { return name.find(key) != std::string_view::npos; };
+	}
+	if (not range_low.empty()) {
+		range_high = prefix_successor(range_low);
+		if (not range_high.empty())
+			where += matching_type == MatchingType::Prefix ? " AND dir_name_folded < ?6" : " AND dir_name_reversed < ?6";
+	}
+	// Outside exact mode the needle may also be an initialism: pga finds payment-gateway-adapter and PaymentGatewayAdapter
+	const std::string initials = key.empty() or exact ? "" : key;
+
+	// Runs one tier of the plan for the slots still open, streaming paths in place as string_views
+	sqlite3* connection = db.connection();
+	size_t count = 0;
+	auto run = [&](const std::string& sql) {
+		auto stmt = db.prepare(sql);
+		if (not stmt) {
+			std::cerr << "Error querying database: " << sqlite3_errmsg(connection) << std::endl;
+			return SQLITE_ERROR;
+		}
+		sqlite3_bind_text(stmt.get(), 1, dir_name.data(), dir_name.size(), SQLITE_STATIC);
+		sqlite3_bind_text(stmt.get(), 2, like_pattern.data(), like_pattern.size(), SQLITE_STATIC);
+		sqlite3_bind_int64(stmt.get(), 3, static_cast<sqlite3_int64>(max_results - count));
+		if (not trigram_query.empty())
+			sqlite3_bind_text(stmt.get(), 4, trigram_query.data(), trigram_query.size(), SQLITE_STATIC);
+		if (not range_low.empty()) {
+			sqlite3_bind_text(stmt.get(), 5, range_low.data(), range_low.size(), SQLITE_STATIC);
+			sqlite3_bind_text(stmt.get(), 6, range_high.data(), range_high.size(), SQLITE_STATIC);
+		}
+		sqlite3_bind_text(stmt.get(), 7, key.data(), key.size(), SQLITE_STATIC);
+		sqlite3_bind_int64(stmt.get(), 8, bigram_signature(key));
+		if (not top_gram.empty()) {
+			sqlite3_bind_blob(stmt.get(), 9, top_gram.data(), top_gram.size(), SQLITE_STATIC);
+			sqlite3_bind_int(stmt.get(), 10, static_cast<int>(db.get_config().get_promotion_strategy()));
+		}
+
+		int rc;
+		while ((rc = sqlite3_step(stmt.get())) == SQLITE_ROW) {
+			const char* path = reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 0));
+			visit(std::string_view(path, sqlite3_column_bytes(stmt.get(), 0)));
+			count++;
+		}
+		// An interrupted query was superseded by a newer request; its caller just drops the partial result
+		if (rc != SQLITE_DONE and rc != SQLITE_INTERRUPT)
+			std::cerr << "Error querying database: " << sqlite3_errmsg(connection) << std::endl;
+		return rc;
+	};
+
+	if (max_results == 0)
+		return 0;
+	if (key.empty()) {
+		std::string filter = exact ? "dir_name = ?1" : "(dir_name = ?1 OR dir_name LIKE ?2)";
+		run("SELECT path FROM paths WHERE " + filter + " ORDER BY dir_name = ?1 DESC, " + sort_col + " DESC LIMIT ?3;");
+		return count;
+	}
+
+	// Tiers run best first and each only fills the slots left: the name as typed and names equal to it under the key,
+	// then initialisms, then everything else the matching type accepts. Every tier is an index probe, and a tier that
+	// fills max_results ends the query, so a common exact name never pays for the long tail.
+	int rc = run("SELECT path FROM paths WHERE dir_name_folded = ?7 ORDER BY dir_name = ?1 DESC, " + sort_col + " DESC LIMIT ?3;");
+	if (rc == SQLITE_DONE and not initials.empty() and count < max_results)
+		rc = run("SELECT path FROM paths WHERE dir_name_initials = ?7 AND dir_name_folded <> ?7 ORDER BY " + sort_col + " DESC LIMIT ?3;");
+	if (rc == SQLITE_DONE and not exact and count < max_results) {
+		const PromotionStrategy strategy = db.get_config().get_promotion_strategy();
+		// One- and two-byte keys match most of the index; their best rows are already listed in top_matches
+		if (key.size() <= 2)
+			top_gram = STATS_KINDS[matching_type == MatchingType::Prefix ? 1 : matching_type == MatchingType::Suffix ? 2 : 0] + key;
+		if (not top_gram.empty() and serves_top_matches(top_gram, strategy, max_results)) {
+			rc = run("SELECT p.path FROM top_matches AS t CROSS JOIN paths AS p ON p.id = t.id WHERE t.gram = ?9 AND t.strategy = ?10 "
+				"AND p.dir_name_folded <> ?7 AND p.dir_name_initials <> ?7 ORDER BY t.rank DESC LIMIT ?3;");
+		} else {
+			// Short keys can match most of the table. Walking rows best first on the sort column's index visits about
+			// open * names / matches rows before the slots fill; the filter visits every match its index finds (every row
+			// for the bigram scan) and sorts them. The estimate is an upper bound from match_stats; long keys always filter.
+			bool walk = false;
+			int64_t matches = 0, names = 0;
+			if (key.size() <= SHORT_KEY_BYTES and estimate_matches(matching_type, key, matches, names) and matches > 0) {
+				double walked = static_cast<double>(max_results - count) * names / matches;
+				double filtered = trigram_query.empty() and matching_type == MatchingType::Contains ? names : matches;
+				walk = walked < filtered;
+			}
+			const std::string sort_index = strategy == PromotionStrategy::RECENTLY_ACCESSED ? "idx_paths_recency" : "idx_paths_frequency";
+			rc = run("SELECT path FROM paths" + (walk ? " INDEXED BY " + sort_index : std::string()) + " WHERE " + where
+				+ " AND dir_name_folded <> ?7 AND dir_name_initials <> ?7 ORDER BY " + (walk ? "" : "+") + sort_col + " DESC LIMIT ?3;");
+		}
+	}
+
+	// Too few answers might mean a typo: top up with names a few edits away from the needle
+	if (rc == SQLITE_DONE and count < max_results)
+		count += for_each_typo_match(key, initials, key_matches, sort_col, max_results - count, visit);
+
+	return count;
+}
+
+
+// Edits allowed for a needle of `length` bytes; short needles are within a couple of edits of almost every name
+static int typo_budget(size_t length) {
+	return length < 4 ? 0 : length < 8 ? 1 : 2;
+}
+
+
+std::vector<std::pair<int, std::string>> PathsTable::similar_names(const std::string& needle, int max_distance) const {
+	std::vector<std::pair<int, std::string>> names;
+	const std::string target = Unicode::match_key(needle);
+	const size_t m = target.size();
+
+	// Seeks into idx_paths_folded: the first key at or after a bound, and the first key after a name
+	sqlite3* connection = db.connection();
+	auto at_or_after = db.prepare("SELECT dir_name_folded FROM paths WHERE dir_name_folded >= ? ORDER BY dir_name_folded LIMIT 1;");
+	auto after = db.prepare("SELECT dir_name_folded FROM paths WHERE dir_name_folded > ? ORDER BY dir_name_folded LIMIT 1;");
+	if (not at_or_after or not after) {
+		std::cerr << "Error querying database: " << sqlite3_errmsg(connection) << std::endl;
+		return names;
+	}
+	auto seek = [&](sqlite3_stmt* stmt, const std::string& key, std::string& name) {
+		sqlite3_bind_text(stmt, 1, key.data(), key.size(), SQLITE_STATIC);
+		bool found = sqlite3_step(stmt) == SQLITE_ROW;
+		if (found)
+			name.assign(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)), sqlite3_column_bytes(stmt, 0));
+		sqlite3_reset(stmt);
+		return found;
+	};
+
+	// A Levenshtein automaton (with transpositions) simulated one dynamic-programming row per character, walked over
+	// the sorted, distinct folded names. rows[d] is the automaton state after the first d characters of the current
+	// name, so rows for a prefix shared with the previous name are reused, and once every entry of a row exceeds the
+	// budget no name with that prefix can match: the walk seeks straight past all of them.
+	std::vector<std::vector<int>> rows(1, std::vector<int>(m + 1));
+	for (size_t j = 0; j <= m; j++)
+		rows[0][j] = static_cast<int>(j);
+
+	std::string previous, name;
+	bool found = seek(at_or_after.get(), "", name);
+	while (found) {
+		size_t depth = 0;
+		while (depth < previous.size() and depth < name.size() and depth + 1 < rows.size() and previous[depth] == name[depth])
+			depth++;
+		rows.resize(depth + 1);
+
+		std::string skip_to;
+		for (size_t d = depth + 1; d <= name.size(); d++) {
+			const std::vector<int>& above = rows[d - 1];
+			std::vector<int> row(m + 1);
+			row[0] = static_cast<int>(d);
+			int lowest = row[0];
+			for (size_t j = 1; j <= m; j++) {
+				int cost = name[d - 1] == target[j - 1] ? 0 : 1;
+				row[j] = std::min({ above[j] + 1, row[j - 1] + 1, above[j - 1] + cost });
+				if (d > 1 and j > 1 and name[d - 1] == target[j - 2] and name[d - 2] == target[j - 1])
+					row[j] = std::min(row[j], rows[d - 2][j - 2] + 1);
+				lowest = std::min(lowest, row[j]);
+			}
+			rows.push_back(std::move(row));
+			if (lowest > max_distance) {
+				skip_to = prefix_successor(name.substr(0, d));
+				break;
+			}
+		}
+		previous = name;
+
+		if (not skip_to.empty()) {
+			found = seek(at_or_after.get(), skip_to, name);
+			continue;
+		}
+		if (rows.size() == name.size() + 1 and rows.back()[m] <= max_distance)
+			names.emplace_back(rows.back()[m], name);
+		found = seek(after.get(), previous, name);
+	}
+
+	std::sort(names.begin(), names.end());
+	return names;
+}
+
+
+size_t PathsTable::for_each_typo_match(const std::string& key, const std::string& initials,
+	const std::function<bool(std::string_view)>& already_matched, const std::string& sort_col, size_t limit,
+	const std::function<void(std::string_view)>& visit) const {
+	int budget = typo_budget(key.size());
+	if (budget == 0 or db.poll_abort())
+		return 0;
+
+	sqlite3* connection = db.connection();
+	std::string sql = "SELECT path FROM paths WHERE dir_name_folded = ?1 AND (?3 = '' OR dir_name_initials <> ?3) "
+		"ORDER BY " + sort_col + " DESC LIMIT ?2;";
+	auto stmt = db.prepare(sql);
+	if (not stmt) {
+		std::cerr << "Error querying database: " << sqlite3_errmsg(connection) << std::endl;
+		return 0;
+	}
+
+	size_t count = 0;
+	for (const auto& [distance, name] : similar_names(key, budget)) {
+		if (count >= limit)
+			break;
+		// Every first-pass filter is a function of the key, so names it already returned are skipped whole
+		if (already_matched(name))
+			continue;
+		sqlite3_bind_text(stmt.get(), 1, name.data(), name.size(), SQLITE_STATIC);
+		sqlite3_bind_int64(stmt.get(), 2, static_cast<sqlite3_int64>(limit - count));
+		sqlite3_bind_text(stmt.get(), 3, initials.data(), initials.size(), SQLITE_STATIC);
+		while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+			const char* path = reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 0));
+			visit(std::string_view(path, sqlite3_column_bytes(stmt.get(), 0)));
+			count++;
+		}
+		sqlite3_reset(stmt.get());
+	}
+	return count;
+}
+
+
+size_t PathsTable::for_each_fuzzy_match(const std::string& dir_name, const std::function<void(std::string_view)>& visit) const {
+	sqlite3* connection = db.connection();
+	fuzzy_index.sync(connection);
+	const bool by_frequency = db.get_config().get_promotion_strategy() == PromotionStrategy::FREQUENCY_BASED;
+	auto matches = fuzzy_index.top_k(dir_name, db.get_config().get_max_results(), by_frequency, [&] { return db.poll_abort(); });
+	if (db.was_aborted())
+		return 0;
+
+	// Only the winners' paths are read back, by primary key
+	auto stmt = db.prepare("SELECT path FROM paths WHERE id = ?;");
+	if (not stmt) {
+		std::cerr << "Error querying database: " << sqlite3_errmsg(connection) << std::endl;
+		return 0;
+	}
+
+	size_t count = 0;
+	for (const auto& match : matches) {
+		sqlite3_bind_int64(stmt.get(), 1, match.id);
+		if (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+			const char* path = reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 0));
+			visit(std::string_view(path, sqlite3_column_bytes(stmt.get(), 0)));
+			count++;
+		}
+		sqlite3_reset(stmt.get());
+	}
+	return count;
+}
+
+
+size_t PathsTable::for_each_regex_match(const std::string& pattern, const std::function<void(std::string_view)>& visit) const {
+	std::regex regex;
+	try {
+		regex = std::regex(pattern, std::regex::ECMAScript | std::regex::icase | std::regex::optimize);
+	} catch (const std::regex_error& e) {
+		std::cerr << "Invalid regular expression '" << pattern << "': " << e.what() << std::endl;
+		return 0;
+	}
+
+	// A pattern with a '/' in it is matched against whole paths, anything else against directory names. Names have
+	// the trigram index to pick candidates from; paths are prefiltered with instr() on the literals a match needs.
+	const bool full_path = pattern.find('/') != std::string::npos;
+	const TrigramQuery required = TrigramQuery::from_regex(pattern, not full_path);
+	std::vector<std::string> binds;
+	std::string where;
+	if (full_path) {
+		where = required.to_sql("path", binds);
+	} else if (std::string fts = required.to_fts(); not fts.empty()) {
+		where = "id IN (SELECT rowid FROM paths_trigram WHERE paths_trigram MATCH ?)";
+		binds.push_back(std::move(fts));
+	}
+
+	const std::string sort_col = sort_column(db.get_config().get_promotion_strategy());
+	const size_t max_results = static_cast<size_t>(std::max(db.get_config().get_max_results(), 0));
+	std::string sql = "SELECT path, " + std::string(full_path ? "path" : "dir_name") + " FROM paths"
+		+ (where.empty() ? "" : " WHERE " + where) + " ORDER BY " + sort_col + " DESC;";
+
+	sqlite3* connection = db.connection();
+	auto stmt = db.prepare(sql);
+	if (not stmt) {
+		std::cerr << "Error querying database: " << sqlite3_errmsg(connection) << std::endl;
+		return 0;
+	}
+	for (size_t k = 0; k < binds.size(); k++)
+		sqlite3_bind_text(stmt.get(), static_cast<int>(k + 1), binds[k].data(), binds[k].size(), SQLITE_STATIC);
+
+	// Candidates come best first, so the regex stops running once enough of them have matched
+	size_t count = 0, seen = 0;
+	int rc = SQLITE_DONE;
+	while (count < max_results and (rc = sqlite3_step(stmt.get())) == SQLITE_ROW) {
+		if (++seen % 1024 == 0 and db.poll_abort())
+			return 0;
+		const char* subject = reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 1));
+		if (not std::regex_search(subject, subject + sqlite3_column_bytes(stmt.get(), 1), regex))
+			continue;
+		const char* path = reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 0));
+		visit(std::string_view(path, sqlite3_column_bytes(stmt.get(), 0)));
+		count++;
+	}
+	if (count < max_results and rc != SQLITE_DONE and rc != SQLITE_INTERRUPT)
+		std::cerr << "Error querying database: " << sqlite3_errmsg(connection) << std::endl;
+	return count;
+}
+
+
+size_t PathsTable::for_each_expansion(const std::string& abbreviated, const std::function<void(std::string_view)>& visit) const {
+	// Relative paths depend on the working directory, so only absolute (or ~) ones expand
+	std::string input = abbreviated;
+	if (input.starts_with('~')) {
+		const char* home = std::getenv("HOME");
+		if (home == nullptr or (input.size() > 1 and input[1] != '/'))
+			return 0;
+		input = home + input.substr(1);
+	}
+	if (not input.starts_with('/'))
+		return 0;
+
+	std::vector<std::string> segments;
+	for (size_t start = 1; start < input.size();) {
+		size_t end = std::min(input.find('/', start), input.size());
+		if (end > start)
+			segments.push_back(input.substr(start, end - start));
+		start = end + 1;
+	}
+	for (const auto& segment : segments)
+		if (segment == "." or segment == "..")
+			return 0;
+	if (segments.empty())
+		return 0;
+
+	const std::string sort_col = sort_column(db.get_config().get_promotion_strategy());
+	const size_t max_results = static_cast<size_t>(std::max(db.get_config().get_max_results(), 0));
+	// Bounds the expansions carried from one level to the next
+	constexpr size_t MAX_FRONTIER = 64;
+
+	sqlite3* connection = db.connection();
+	std::string sql = "SELECT path, dir_name_folded, " + sort_col + " FROM paths WHERE parent_path = ?1 AND dir_name_folded >= ?2 "
+		"AND (?3 = '' OR dir_name_folded < ?3) ORDER BY " + sort_col + " DESC LIMIT ?4;";
+	auto stmt = db.prepare(sql);
+	if (not stmt) {
+		std::cerr << "Error querying database: " << sqlite3_errmsg(connection) << std::endl;
+		return 0;
+	}
+
+	// Each level keeps the best expansions so far: names spelled out in full first, then by promotion rank
+	struct Expansion { bool exact; int64_t rank; std::string path; };
+	std::vector<Expansion> frontier = { { true, 0, "" } };
+	bool indexed = false;
+	for (size_t level = 0; level < segments.size(); level++) {
+		const std::string low = Unicode::match_key(segments[level]);
+		const std::string high = prefix_successor(low);
+		const size_t keep = level + 1 == segments.size() ? max_results : MAX_FRONTIER;
+
+		std::vector<Expansion> next;
+		for (const auto& parent : frontier) {
+			sqlite3_bind_text(stmt.get(), 1, parent.path.data(), parent.path.size(), SQLITE_STATIC);
+			sqlite3_bind_text(stmt.get(), 2, low.data(), low.size(), SQLITE_STATIC);
+			sqlite3_bind_text(stmt.get(), 3, high.data(), high.size(), SQLITE_STATIC);
+			sqlite3_bind_int64(stmt.get(), 4, static_cast<sqlite3_int64>(keep));
+			while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+				std::string_view name(reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 1)), sqlite3_column_bytes(stmt.get(), 1));
+				next.push_back({ parent.exact and name == low, sqlite3_column_int64(stmt.get(), 2),
+					std::string(reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 0)), sqlite3_column_bytes(stmt.get(), 0)) });
+			}
+			sqlite3_reset(stmt.get());
+		}
+
+		// Levels above the indexed tree (like /Users/me) are taken literally, as long as nothing below matched yet
+		if (next.empty()) {
+			if (indexed)
+				return 0;
+			frontier = { { true, 0, frontier[0].path + "/" + segments[level] } };
+			continue;
+		}
+		indexed = true;
+
+		size_t kept = std::min(next.size(), keep);
+		std::partial_sort(next.begin(), next.begin() + kept, next.end(), [](const Expansion& a, const Expansion& b) {
+			return a.exact != b.exact ? a.exact : a.rank > b.rank;
+		});
+		next.resize(kept);
+		frontier = std::move(next);
+	}
+	// The whole path was literal and nothing in the index backs it
+	if (not indexed or frontier.empty())
+		return 0;
+
+	for (const auto& expansion : frontier)
+		visit(expansion.path);
+	return frontier.size();
+}
+
+
+size_t PathsTable::for_each_keyword_match(const std::vector<std::string>& keywords, const std::function<void(std::string_view)>& visit) const {
+	if (keywords.empty())
+		return 0;
+	// Keywords match through their keys like everything else, so "my-service" finds My_Service and "über" Über
+	std::vector<std::string> folded;
+	for (const auto& keyword : keywords) {
+		folded.push_back(Unicode::match_key(keyword));
+		if (folded.back().empty())
+			return 0;
+	}
+
+	sqlite3* connection = db.connection();
+	auto prepare = [&](const std::string& sql) {
+		auto stmt = db.prepare(sql);
+		if (not stmt)
+			std::cerr << "Error querying database: " << sqlite3_errmsg(connection) << std::endl;
+		return stmt;
+	};
+
+	// Each keyword's candidates are the union of the posting lists of every component containing it; a path has to
+	// be a candidate for all of them, so the lists are intersected, smallest first
+	auto components = prepare("SELECT postings FROM path_components WHERE instr(component, ?) > 0;");
+	if (not components)
+		return 0;
+	std::vector<std::vector<int64_t>> candidates;
+	for (const auto& keyword : folded) {
+		std::vector<int64_t> ids;
+		sqlite3_bind_text(components.get(), 1, keyword.data(), keyword.size(), SQLITE_STATIC);
+		while (sqlite3_step(components.get()) == SQLITE_ROW) {
+			const char* blob = static_cast<const char*>(sqlite3_column_blob(components.get(), 0));
+			Postings::decode(std::string_view(blob, sqlite3_column_bytes(components.get(), 0)), ids);
+		}
+		sqlite3_reset(components.get());
+		std::sort(ids.begin(), ids.end());
+		ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+		if (ids.empty() or db.poll_abort())
+			return 0;
+		candidates.push_back(std::move(ids));
+	}
+	std::sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) { return a.size() < b.size(); });
+	std::vector<int64_t> ids = std::move(candidates[0]);
+	for (size_t i = 1; i < candidates.size() and not ids.empty(); i++) {
+		std::vector<int64_t> both;
+		std::set_intersection(ids.begin(), ids.end(), candidates[i].begin(), candidates[i].end(), std::back_inserter(both));
+		ids = std::move(both);
+	}
+
+	// Posting lists don't say where in the path a component sits, so the order is checked on the paths themselves
+	const std::string sort_col = sort_column(db.get_config().get_promotion_strategy());
+	auto row = prepare("SELECT path, " + sort_col + " FROM paths WHERE id = ?;");
+	if (not row)
+		return 0;
+	std::vector<std::pair<int64_t, std::string>> ranked;
+	for (int64_t id : ids) {
+		sqlite3_bind_int64(row.get(), 1, id);
+		if (sqlite3_step(row.get()) == SQLITE_ROW) {
+			std::string path(reinterpret_cast<const char*>(sqlite3_column_text(row.get(), 0)), sqlite3_column_bytes(row.get(), 0));
+			if (components_in_order(path, folded))
+				ranked.emplace_back(sqlite3_column_int64(row.get(), 1), std::move(path));
+		}
+		sqlite3_reset(row.get());
+	}
+
+	size_t count = std::min(ranked.size(), static_cast<size_t>(std::max(db.get_config().get_max_results(), 0)));
+	std::partial_sort(ranked.begin(), ranked.begin() + count, ranked.end(), [](const auto& a, const auto& b) {
+		return a.first != b.first ? a.first > b.first : a.second < b.second;
+	});
+	for (size_t i = 0; i < count; i++)
+		visit(ranked[i].second);
+	return count;
+}
+
+
+bool PathsTable::access(const std::string& path) {
 	long long time_now = Time::now();
+	sqlite3* connection = db.connection();
 	try {
-		db << "UPDATE paths SET last_accessed = ?, access_count = access_count + 1 WHERE path = ?;"
-			<< time_now
-			<< path;
+		db << "BEGIN TRANSACTION;";
 	} catch (const sqlite::sqlite_exception& e) {
 		std::cerr << "Error updating database: " << e.what() << std::endl;
+		return false;
 	}
+
+	int64_t id = -1, last_accessed = 0, access_count = 0;
+	std::string key;
+	bool ok = false;
+	if (auto stmt = db.prepare("UPDATE paths SET last_accessed = ?, access_count = access_count + 1 WHERE path = ? "
+		"RETURNING id, last_accessed, access_count, dir_name_folded;")) {
+		sqlite3_bind_int64(stmt.get(), 1, time_now);
+		sqlite3_bind_text(stmt.get(), 2, path.data(), path.size(), SQLITE_STATIC);
+
+		// Keep a loaded fuzzy index current without reloading it
+		int rc;
+		while ((rc = sqlite3_step(stmt.get())) == SQLITE_ROW) {
+			id = sqlite3_column_int64(stmt.get(), 0);
+			last_accessed = sqlite3_column_int64(stmt.get(), 1);
+			access_count = sqlite3_column_int64(stmt.get(), 2);
+			key.assign(reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 3)), sqlite3_column_bytes(stmt.get(), 3));
+			fuzzy_index.touch(connection, id, last_accessed, access_count);
+		}
+		ok = rc == SQLITE_DONE;
+	}
+
+	// The new ranks only ever go up, so the row joins (or moves up) the top lists of its grams that it now makes,
+	// and whatever falls off the end of a full list leaves it
+	if (ok and id >= 0) {
+		const int64_t since = sqlite3_total_changes64(connection);
+		// Indexed by PromotionStrategy
+		const int64_t ranks[] = { last_accessed, access_count };
+		auto upsert = db.prepare("INSERT INTO top_matches (gram, strategy, id, rank) SELECT ?1, ?2, ?3, ?4 "
+			"WHERE ?4 >= (SELECT MIN(rank) FROM top_matches WHERE gram = ?1 AND strategy = ?2) "
+			"ON CONFLICT DO UPDATE SET rank = excluded.rank;");
+		auto trim = db.prepare("DELETE FROM top_matches WHERE gram = ?1 AND strategy = ?2 AND id NOT IN "
+			"(SELECT id FROM top_matches WHERE gram = ?1 AND strategy = ?2 ORDER BY rank DESC LIMIT ?3);");
+		ok = upsert and trim;
+
+		std::vector<size_t> counters;
+		for_each_gram(key, [&](size_t counter) { counters.push_back(counter); });
+		std::sort(counters.begin(), counters.end());
+		counters.erase(std::unique(counters.begin(), counters.end()), counters.end());
+		for (size_t counter : counters) {
+			std::vector<char> gram = gram_blob(counter);
+			for (int strategy = 0; ok and strategy < 2; strategy++) {
+				sqlite3_bind_blob(upsert.get(), 1, gram.data(), gram.size(), SQLITE_STATIC);
+				sqlite3_bind_int(upsert.get(), 2, strategy);
+				sqlite3_bind_int64(upsert.get(), 3, id);
+				sqlite3_bind_int64(upsert.get(), 4, ranks[strategy]);
+				ok = sqlite3_step(upsert.get()) == SQLITE_DONE;
+				sqlite3_reset(upsert.get());
+				if (not ok or sqlite3_changes(connection) == 0)
+					continue;
+				sqlite3_bind_blob(trim.get(), 1, gram.data(), gram.size(), SQLITE_STATIC);
+				sqlite3_bind_int(trim.get(), 2, strategy);
+				sqlite3_bind_int(trim.get(), 3, db.get_config().get_max_results());
+				ok = sqlite3_step(trim.get()) == SQLITE_DONE;
+				sqlite3_reset(trim.get());
+			}
+		}
+		try {
+			if (ok)
+				bump_generation();
+		} catch (const sqlite::sqlite_exception& e) {
+			ok = false;
+		}
+		// None of this touched paths
+		fuzzy_index.skip_changes(connection, since);
+	}
+
+	try {
+		if (ok) {
+			db << "COMMIT;";
+			return true;
+		}
+		std::cerr << "Error updating database: " << sqlite3_errmsg(connection) << std::endl;
+		db << "ROLLBACK;";
+	} catch (const sqlite::sqlite_exception& e) {
+		std::cerr << "Error updating database: " << e.what() << std::endl;
+	}
+	return false;
 }
 
 
@@ -160,11 +1057,16 @@ void PathsTable::bulk_insert(const std::vector<std::tuple<std::string, std::stri
 		db << "BEGIN TRANSACTION;";
 		
 		
-		auto stmt = db << "INSERT INTO paths (path, dir_name, last_accessed) VALUES (?, ?, ?);";
+		auto stmt = db << "INSERT INTO paths (path, dir_name, dir_name_folded, dir_name_reversed, parent_path, dir_name_initials, "
+			"dir_name_bigrams, last_accessed) VALUES (?, ?, ?, ?, ?, ?, ?, ?);";
 		for (const auto& [path, dir_name] : rows) {
-			stmt << path << dir_name << last_accessed;
+			std::string key = Unicode::match_key(dir_name);
+			stmt << path << dir_name << key << reversed_key(dir_name) << get_parent_path(path) << initialism(dir_name)
+				<< bigram_signature(key) << last_accessed;
 			stmt++;
 		}
+		rebuild_components();
+		rebuild_stats();
 		
 		db << "COMMIT;";
 	} catch (const sqlite::sqlite_exception& e) {
@@ -193,6 +1095,8 @@ void PathsTable::delete_paths(const std::vector<std::string>& paths) {
 			stmt << path;
 			stmt++;
 		}
+		rebuild_components();
+		rebuild_stats();
 
 		db << "COMMIT;";
 	} catch (const sqlite::sqlite_exception& e) {
@@ -5,18 +5,7 @@
 void ShortcutsTable::create_table() const {
 	try {
 		db << "BEGIN TRANSACTION;";
-		
-		db << "CREATE TABLE IF NOT EXISTS shortcuts ("
-		"id INTEGER PRIMARY KEY AUTOINCREMENT, "
-		"shortcut TEXT NOT NULL, "
-		"command TEXT NOT NULL, "
-		"last_accessed INTEGER NOT NULL, "
-		"access_count INTEGER NOT NULL DEFAULT 0"
-		");";
-		db << "CREATE UNIQUE INDEX IF NOT EXISTS idx_shortcut ON shortcuts (shortcut);";
-		db << "CREATE INDEX IF NOT EXISTS idx_shortcuts_recency ON shortcuts (shortcut, last_accessed DESC);";
-		db << "CREATE INDEX IF NOT EXISTS idx_shortcuts_freq ON shortcuts (shortcut, access_count DESC);";
-		
+		create_schema();
 		db << "COMMIT;";
 	} catch (const sqlite::sqlite_exception& e) {
 		db << "ROLLBACK;";
@@ -25,28 +14,58 @@ void ShortcutsTable::create_table() const {
 }
 
 
+void ShortcutsTable::create_schema() const {
+	db << "CREATE TABLE IF NOT EXISTS shortcuts ("
+	"id INTEGER PRIMARY KEY AUTOINCREMENT, "
+	"shortcut TEXT NOT NULL, "
+	"command TEXT NOT NULL, "
+	"last_accessed INTEGER NOT NULL, "
+	"access_count INTEGER NOT NULL DEFAULT 0"
+	");";
+	db << "CREATE UNIQUE INDEX IF NOT EXISTS idx_shortcut ON shortcuts (shortcut);";
+	db << "CREATE INDEX IF NOT EXISTS idx_shortcuts_recency ON shortcuts (shortcut, last_accessed DESC);";
+	db << "CREATE INDEX IF NOT EXISTS idx_shortcuts_freq ON shortcuts (shortcut, access_count DESC);";
+}
+
+
 void ShortcutsTable::drop_table() const {
 	db << "DROP TABLE IF EXISTS shortcuts;";
 }
 
 
+// Shortcut lookups run on every call, so they go through the connection's statement cache
+bool ShortcutsTable::select_command(const std::string& shortcut, std::string& command, const char* error_prefix) const {
+	sqlite3* connection = db.connection();
+	auto stmt = db.prepare("SELECT command FROM shortcuts WHERE shortcut = ? LIMIT 1;");
+	if (not stmt) {
+		std::cerr << error_prefix << sqlite3_errmsg(connection) << std::endl;
+		return false;
+	}
+	sqlite3_bind_text(stmt.get(), 1, shortcut.data(), shortcut.size(), SQLITE_STATIC);
+	int rc = sqlite3_step(stmt.get());
+	if (rc == SQLITE_ROW) {
+		command.assign(reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 0)), sqlite3_column_bytes(stmt.get(), 0));
+		return true;
+	}
+	if (rc != SQLITE_DONE)
+		std::cerr << error_prefix << sqlite3_errmsg(connection) << std::endl;
+	return false;
+}
+
+
 std::vector<std::string> ShortcutsTable::query(const std::string& input) const {
 	// We only do exact matches for shortcuts (might change this in the future)
 	std::vector<std::string> results;
-	try {
-		db << "SELECT command FROM shortcuts WHERE shortcut = ? LIMIT 1;" << input >> [&](std::string command) {
-			results.push_back(command);
-		};
-	} catch (const sqlite::sqlite_exception& e) {
-		std::cerr << "Error querying shortcuts: " << e.what() << std::endl;
-	}
+	std::string command;
+	if (select_command(input, command, "Error querying shortcuts: "))
+		results.push_back(command);
 	return results;
 }
 
 
-void ShortcutsTable::access(const std::string& command) {
+bool ShortcutsTable::access(const std::string& command) {
 	// This function is a no-op for shortcuts (for now)
-	return;
+	return true;
 }
 
 
@@ -89,14 +108,6 @@ std::vector<std::string> ShortcutsTable::select_all_shortcuts() const {
 
 std::string ShortcutsTable::select_shortcut_command(const std::string& shortcut) const {
 	std::string command = "";
-	try {
-		db << "SELECT command FROM shortcuts WHERE shortcut = ? LIMIT 1;"
-			<< shortcut >> [&](std::string cmd) {
-			command = cmd;
-		};
-	} catch (const sqlite::sqlite_exception& e) {
-		std::cerr << "Error selecting shortcut command from database: " << e.what() << std::endl;
-	}
-
+	select_command(shortcut, command, "Error selecting shortcut command from database: ");
 	return command;
 }
\ No newline at end of file
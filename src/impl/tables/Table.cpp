@@ -5,6 +5,7 @@
 std::string Table::get_query_pattern(const std::string& dir_name, const std::string& matching_type_override) const {
 	switch (matching_type_override.empty() ? db.get_config().get_matching_type() : TypeConversions::s_to_matching_type(matching_type_override)) {
 		case MatchingType::Exact:
+		case MatchingType::Regex:
 			return dir_name;
 		case MatchingType::Prefix:
 			return dir_name + "%";
@@ -12,6 +13,13 @@ std::string Table::get_query_pattern(const std::string& dir_name, const std::str
 			return "%" + dir_name;
 		case MatchingType::Contains:
 			return "%" + dir_name + "%";
+		case MatchingType::Fuzzy: {
+			// The closest LIKE can get: the characters in order, anything in between
+			std::string pattern = "%";
+			for (char c : dir_name)
+				pattern += std::string(1, c) + "%";
+			return pattern;
+		}
 	}
 	return "";
 }
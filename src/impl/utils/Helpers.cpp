@@ -1,8 +1,16 @@
 #include "Helpers.h"
 #include "Types.h"
+#include "Unicode.h"
 
+#include <algorithm>
+#include <cstdlib>
 #include <string>
+#include <unordered_map>
 #include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 // Helper function to return the deepest directory name in a path
 // Ex. get_deepest_dir("/Users/jameskendrick/Code/Projects/dirvana/cpp/src") will return "src"
@@ -17,6 +25,191 @@ std::string get_dir_name(const std::string& path) {
 	return path.substr(pos + 1);
 }
 
+std::string get_parent_path(const std::string& path) {
+	size_t pos = path.find_last_of('/');
+	return pos == std::string::npos ? "" : path.substr(0, pos);
+}
+
+std::string reversed_key(std::string_view text) {
+	std::string folded = Unicode::match_key(text);
+	std::string key;
+	key.reserve(folded.size());
+
+	// Walk backwards one character at a time, keeping each multi-byte sequence in order
+	size_t end = folded.size();
+	while (end > 0) {
+		size_t start = end - 1;
+		while (start > 0 and (static_cast<unsigned char>(folded[start]) & 0xC0) == 0x80)
+			start--;
+		key.append(folded, start, end - start);
+		end = start;
+	}
+	return key;
+}
+
+std::string initialism(std::string_view name) {
+	auto is_upper = [](char c) { return c >= 'A' and c <= 'Z'; };
+	auto is_lower = [](char c) { return c >= 'a' and c <= 'z'; };
+	auto is_digit = [](char c) { return c >= '0' and c <= '9'; };
+	auto is_separator = [](char c) { return c == '-' or c == '_' or c == '.' or c == ' '; };
+
+	std::string initials;
+	for (size_t i = 0; i < name.size(); i++) {
+		char c = name[i];
+		if (is_separator(c))
+			continue;
+		char previous = i > 0 ? name[i - 1] : '-';
+		char next = i + 1 < name.size() ? name[i + 1] : '\0';
+		bool starts_word = is_separator(previous)
+			or (is_upper(c) and not is_upper(previous))
+			or (is_upper(c) and is_upper(previous) and is_lower(next))
+			or (is_digit(c) and not is_digit(previous));
+		if (not starts_word or (static_cast<unsigned char>(c) & 0xC0) == 0x80)
+			continue;
+		// Keep a whole UTF-8 character, in the same form as the match key the query is compared in
+		size_t length = 1;
+		while (i + length < name.size() and (static_cast<unsigned char>(name[i + length]) & 0xC0) == 0x80)
+			length++;
+		initials += Unicode::match_key(name.substr(i, length));
+	}
+	return initials.size() > 1 ? initials : "";
+}
+
+int64_t bigram_signature(std::string_view key) {
+	uint64_t signature = 0;
+	for (size_t i = 1; i < key.size(); i++) {
+		uint32_t pair = static_cast<unsigned char>(key[i - 1]) << 8 | static_cast<unsigned char>(key[i]);
+		// Multiplicative hash: the top six bits of the product pick the bit
+		signature |= uint64_t(1) << ((pair * 0x9E3779B1u) >> 26);
+	}
+	return static_cast<int64_t>(signature);
+}
+
+std::string prefix_successor(std::string prefix) {
+	while (not prefix.empty() and static_cast<unsigned char>(prefix.back()) == 0xFF)
+		prefix.pop_back();
+	if (not prefix.empty())
+		prefix.back() = static_cast<char>(static_cast<unsigned char>(prefix.back()) + 1);
+	return prefix;
+}
+
+bool is_command(const std::string& name) {
+	// Builtins that take a directory and have no binary on $PATH on every system
+	static constexpr auto builtins = make_static_set({ "cd", "pushd", "source", ".", "exec", "eval", "builtin", "command" });
+	if (name.empty() or name.find('/') != std::string::npos)
+		return false;
+	if (builtins.contains(name) or ArgParsing::system_shell_commands.contains(name))
+		return true;
+
+	// The daemon answers many requests from one process, so $PATH is only searched again once it changes
+	static std::string searched_path;
+	static std::unordered_map<std::string, bool> found;
+	const char* path = std::getenv("PATH");
+	if (searched_path != (path != nullptr ? path : "")) {
+		searched_path = path != nullptr ? path : "";
+		found.clear();
+	}
+	auto [it, inserted] = found.try_emplace(name, false);
+	if (not inserted)
+		return it->second;
+
+	std::string_view dirs = searched_path;
+	while (not dirs.empty()) {
+		size_t end = dirs.find(':');
+		std::string_view dir = dirs.substr(0, end);
+		if (not dir.empty() and access((std::string(dir) + "/" + name).c_str(), X_OK) == 0)
+			return it->second = true;
+		dirs = end == std::string_view::npos ? "" : dirs.substr(end + 1);
+	}
+	return false;
+}
+
+std::string Postings::encode(const std::vector<int64_t>& sorted_ids) {
+	std::string encoded;
+	encoded.reserve(sorted_ids.size() * 2);
+	int64_t previous = 0;
+	for (int64_t id : sorted_ids) {
+		uint64_t gap = static_cast<uint64_t>(id - previous);
+		previous = id;
+		while (gap >= 0x80) {
+			encoded.push_back(static_cast<char>((gap & 0x7F) | 0x80));
+			gap >>= 7;
+		}
+		encoded.push_back(static_cast<char>(gap));
+	}
+	return encoded;
+}
+
+void Postings::decode(std::string_view encoded, std::vector<int64_t>& ids) {
+	int64_t previous = 0;
+	uint64_t gap = 0;
+	int shift = 0;
+	for (char c : encoded) {
+		gap |= static_cast<uint64_t>(static_cast<unsigned char>(c) & 0x7F) << shift;
+		shift += 7;
+		if ((static_cast<unsigned char>(c) & 0x80) == 0) {
+			previous += static_cast<int64_t>(gap);
+			ids.push_back(previous);
+			gap = 0;
+			shift = 0;
+		}
+	}
+}
+
+bool components_in_order(const std::string& path, const std::vector<std::string>& keywords) {
+	// Every component's key, the leaf's last (even when it is empty)
+	std::vector<std::string> keys;
+	for (size_t start = 0; start <= path.size();) {
+		size_t end = std::min(path.find('/', start), path.size());
+		if (end > start or end == path.size())
+			keys.push_back(Unicode::match_key(std::string_view(path).substr(start, end - start)));
+		start = end + 1;
+	}
+	if (keys.back().find(keywords.back()) == std::string::npos)
+		return false;
+
+	size_t next = 0;
+	for (size_t k = 0; k + 1 < keywords.size(); k++) {
+		// The first component from `next` on that contains the keyword, stopping short of the leaf
+		while (next + 1 < keys.size() and keys[next].find(keywords[k]) == std::string::npos)
+			next++;
+		if (next + 1 >= keys.size())
+			return false;
+		next++;
+	}
+	return true;
+}
+
+std::string runtime_path(const std::string& suffix) {
+	// Prefer the per-user runtime dir; fall back to a uid-qualified name in the temp dir
+	const char* runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+	if (runtime_dir != nullptr and runtime_dir[0] != '\0')
+		return std::string(runtime_dir) + "/dirvana" + suffix;
+
+	const char* tmp_dir = std::getenv("TMPDIR");
+	std::string dir = (tmp_dir != nullptr and tmp_dir[0] != '\0') ? tmp_dir : "/tmp";
+	if (dir.back() == '/') dir.pop_back();
+	return dir + "/dirvana-" + std::to_string(getuid()) + suffix;
+}
+
+uint64_t* map_counters(const std::string& path, size_t count, bool create) {
+	int fd = open(path.c_str(), O_RDWR | O_CLOEXEC | (create ? O_CREAT : 0), 0600);
+	if (fd < 0)
+		return nullptr;
+
+	// Concurrent creators all grow the file to the same size, and a fresh file starts at zero
+	const off_t size = static_cast<off_t>(count * sizeof(uint64_t));
+	uint64_t* counters = nullptr;
+	struct stat st;
+	if (fstat(fd, &st) == 0 and (st.st_size >= size or (create and ftruncate(fd, size) == 0))) {
+		void* mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (mapped != MAP_FAILED)
+			counters = static_cast<uint64_t*>(mapped);
+	}
+	close(fd);
+	return counters;
+}
+
 std::string extract_promotion_strategy(const std::string& dirname) {
 	size_t pos = dirname.find_first_of('-');
 	if (pos == std::string::npos)
@@ -31,6 +224,8 @@ MatchingType TypeConversions::s_to_matching_type(const std::string& type) {
 	else if (type == "prefix") return MatchingType::Prefix;
 	else if (type == "suffix") return MatchingType::Suffix;
 	else if (type == "contains") return MatchingType::Contains;
+	else if (type == "fuzzy") return MatchingType::Fuzzy;
+	else if (type == "regex") return MatchingType::Regex;
 	else {
 		std::cerr << "Unknown matching type: " << type << std::endl;
 		return MatchingType::Exact;
@@ -109,25 +304,22 @@ json TypeConversions::exclusion_rules_to_json(const std::vector<ExclusionRule>&
 	return j;
 }
 
-std::pair<bool, Flag> ArgParsing::build_flag(const std::vector<std::string>& flag_parts, const std::string& cmd) {
+std::pair<bool, Flag> ArgParsing::build_flag(std::string_view raw_flag, std::string_view value, std::string_view cmd) {
 	Flag flag;
 
 	flag.cmd = cmd;
 
-	if (flag_parts.size() > 0) {
-		std::string raw_flag = flag_parts[0];
-
-		// Convert -fs to --flags
-		if (raw_flag.starts_with("-") and not raw_flag.starts_with("--")) {
-			// Make sure the short flag is a valid alias
-			std::string short_flag = raw_flag.substr(1);
-			if (ArgParsing::flag_aliases.find(short_flag) == ArgParsing::flag_aliases.end()) {
-				std::cerr << "Invalid flag '-" << short_flag << "'" << std::endl;
-				return {false, flag};
-			}
-			raw_flag = "--" + ArgParsing::flag_aliases.at(short_flag);
+	std::string_view name;
+	if (raw_flag.starts_with("-") and not raw_flag.starts_with("--")) {
+		// Convert -fs to --flags, making sure the short flag is a valid alias
+		std::string_view short_flag = raw_flag.substr(1);
+		const std::string_view* full_name = ArgParsing::flag_aliases.find(short_flag);
+		if (full_name == nullptr) {
+			std::cerr << "Invalid flag '-" << short_flag << "'" << std::endl;
+			return {false, flag};
 		}
-
+		name = *full_name;
+	} else {
 		// Reject invalid flags
 		if (raw_flag.starts_with("---")) {
 			std::cerr << "Invalid flag '" << raw_flag << "'" << std::endl;
@@ -135,21 +327,20 @@ std::pair<bool, Flag> ArgParsing::build_flag(const std::vector<std::string>& fla
 		}
 
 		// Convert flags to their implied names
-		if (raw_flag_to_implied.find(raw_flag) != raw_flag_to_implied.end())
-			raw_flag = raw_flag_to_implied.at(raw_flag);
+		if (const std::string_view* implied = ArgParsing::raw_flag_to_implied.find(raw_flag))
+			raw_flag = *implied;
 
 		// Now we should have a flag starting with '--'
-		std::string trimmed_flag = raw_flag.substr(2);
-		if (std::find(full_flag_names.begin(), full_flag_names.end(), trimmed_flag) == full_flag_names.end()) {
-			std::cerr << "Invalid flag '--" << trimmed_flag << "'" << std::endl;
-			return {false, flag};
-		}
+		name = raw_flag.substr(2);
+	}
 
-		flag.flag = trimmed_flag;
+	if (not ArgParsing::full_flag_names.contains(name)) {
+		std::cerr << "Invalid flag '--" << name << "'" << std::endl;
+		return {false, flag};
 	}
 
-	if (flag_parts.size() > 1)
-		flag.value = flag_parts[1];
+	flag.flag = name;
+	flag.value = value;
 
 	return {true, flag};
 }
@@ -157,78 +348,75 @@ std::pair<bool, Flag> ArgParsing::build_flag(const std::vector<std::string>& fla
 std::tuple<bool, std::vector<std::string>, std::vector<Flag>> ArgParsing::process_args(int argc, char* argv[]) {
 	std::vector<std::string> cmd_parts;
 	std::vector<Flag> flags;
-	std::vector<std::string> curr_flag_parts;
-	bool found_flag = false;
+	cmd_parts.reserve(argc > 3 ? argc - 3 : 0);
 
 	// Known shell/system binary: pass argv through so flags like cp -r are not parsed as Dirvana flags
-	const std::string first_arg = argc > 3 ? argv[3] : "";
-	if (!first_arg.empty() && ArgParsing::system_shell_commands.count(first_arg)) {
+	if (argc > 3 && ArgParsing::system_shell_commands.contains(argv[3])) {
 		for (int i = 3; i < argc; i++)
-			cmd_parts.push_back(argv[i]);
+			cmd_parts.emplace_back(argv[i]);
 		return {true, cmd_parts, flags};
 	}
 
+	// `dv -k proj api`: every word after the flag is a keyword, so none of them is read as the flag's value
+	if (argc > 3 && (std::string_view(argv[3]) == "-k" || std::string_view(argv[3]) == "--keywords")) {
+		for (int i = 4; i < argc; i++)
+			cmd_parts.emplace_back(argv[i]);
+		flags.push_back({"", "keywords"});
+		return {true, cmd_parts, flags};
+	}
 
+	// A flag owns every arg after it up to the next flag; the first of those is its value.
+	// We associate the flag with the last command part.
+	int flag_start = -1;
+	auto save_flag = [&](int flag_end) {
+		std::string_view value = flag_start + 1 < flag_end ? argv[flag_start + 1] : "";
+		std::string_view cmd = cmd_parts.empty() ? "" : cmd_parts.back();
+		auto [success, flag] = ArgParsing::build_flag(argv[flag_start], value, cmd);
+		if (not success or not ArgParsing::validate_flag(flag))
+			return false;
+		flags.push_back(std::move(flag));
+		return true;
+	};
 
 	// Start from index 3 to skip the program name, call type (--enter or --tab), and "dv"
 	for (int i = 3; i < argc; i++) {
-		std::string arg = argv[i];
+		std::string_view arg = argv[i];
 
 		// Condition that indicates the start of a flag
 		if (arg.starts_with("-") and arg.size() > 1) {
-			// If we were already building a flag, save it
-			if (found_flag and !curr_flag_parts.empty()) {
-				std::string cmd = cmd_parts.empty() ? "" : cmd_parts.back(); // We associate the flag with the last command part
-				auto [success, flag] = ArgParsing::build_flag(curr_flag_parts, cmd);
-
-				if (success && ArgParsing::validate_flag(flag))
-					flags.push_back(flag);
-				else
-					// If the flag is invalid, we stop processing further
-					return {false, {}, {}};
-				curr_flag_parts.clear();
-			} else {
-				found_flag = true;
-			}
+			// If we were already building a flag, save it. If the flag is invalid, we stop processing further
+			if (flag_start >= 0 and not save_flag(i))
+				return {false, {}, {}};
+			flag_start = i;
+		} else if (flag_start < 0) {
+			// After we start building a flag, all subsequent args belong to the flag (or another flag)
+			cmd_parts.emplace_back(arg);
 		}
-
-		// After we start building a flag, all subsequent args belong to the flag (or another flag)
-		if (found_flag)
-			curr_flag_parts.push_back(arg);
-		else
-			cmd_parts.push_back(arg);
 	}
 
 	// If we ended while building a flag, save it
-	if (found_flag and !curr_flag_parts.empty()) {
-		auto [success, flag] = ArgParsing::build_flag(curr_flag_parts, cmd_parts.empty() ? "" : cmd_parts.back());
-		if (success && ArgParsing::validate_flag(flag))
-			flags.push_back(flag);
-		else
-			// If the flag is invalid, we stop processing
-			return {false, {}, {}};
-	}
+	if (flag_start >= 0 and not save_flag(argc))
+		return {false, {}, {}};
 
 	return {true, cmd_parts, flags};
 }
 
 bool ArgParsing::validate_flag(const Flag& flag) {
 	// Determine which set of valid flags to use based on the associated command
-	std::string associated_cmd = flag.cmd;
-	if (ArgParsing::valid_flags.find(associated_cmd) == ArgParsing::valid_flags.end())
+	const std::span<const FlagSpec>* specs = ArgParsing::valid_flags.find(flag.cmd);
+	if (specs == nullptr)
 		return false;
-	const auto& flags = ArgParsing::valid_flags.at(associated_cmd);
 
 	// Check if the flag is valid for the associated command
-	auto it = std::find_if(flags.begin(), flags.end(), [&flag](const auto& pair) {
-		return pair.first == flag.flag;
+	auto it = std::find_if(specs->begin(), specs->end(), [&flag](const FlagSpec& spec) {
+		return spec.name == flag.flag;
 	});
-	if (it == flags.end()) {
-		std::cerr << "Invalid flag '--" << flag.flag << "' for command '" << associated_cmd << "'" << std::endl;
+	if (it == specs->end()) {
+		std::cerr << "Invalid flag '--" << flag.flag << "' for command '" << flag.cmd << "'" << std::endl;
 		return false;
 	}
 
-	bool requires_value = it->second;
+	bool requires_value = it->requires_value;
 	if (requires_value && flag.value.empty()) {
 		std::cerr << "Flag --" << flag.flag << " requires a value" << std::endl;
 		return false;
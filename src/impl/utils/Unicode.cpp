@@ -0,0 +1,129 @@
+#include "Unicode.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace {
+	struct FoldRange { char32_t first, last; int32_t delta; int32_t stride; };
+	struct FoldSpecial { char32_t from; char32_t to[3]; };
+	struct Composition { char32_t starter, mark, composite; };
+
+#include "UnicodeTables.inc"
+
+	// Hangul syllables compose algorithmically rather than through the table
+	constexpr char32_t HANGUL_S = 0xAC00, HANGUL_L = 0x1100, HANGUL_V = 0x1161, HANGUL_T = 0x11A7;
+	constexpr char32_t HANGUL_L_COUNT = 19, HANGUL_V_COUNT = 21, HANGUL_T_COUNT = 28;
+	constexpr char32_t HANGUL_N_COUNT = HANGUL_V_COUNT * HANGUL_T_COUNT;
+
+	bool is_separator(char32_t c) { return c == '_' or c == '-' or c == ' '; }
+
+	// Decodes one UTF-8 sequence at `i`; a malformed byte decodes to itself and is re-encoded as-is
+	char32_t decode(std::string_view text, size_t& i, bool& valid) {
+		unsigned char lead = text[i];
+		size_t length = lead < 0x80 ? 1 : (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xE ? 3 : (lead >> 3) == 0x1E ? 4 : 0;
+		valid = length > 0 and i + length <= text.size();
+		char32_t cp = length == 1 ? lead : length == 2 ? lead & 0x1F : length == 3 ? lead & 0x0F : lead & 0x07;
+		for (size_t k = 1; valid and k < length; k++) {
+			unsigned char next = text[i + k];
+			valid = (next & 0xC0) == 0x80;
+			cp = (cp << 6) | (next & 0x3F);
+		}
+		if (not valid) {
+			i++;
+			return lead;
+		}
+		i += length;
+		return cp;
+	}
+
+	void encode(char32_t cp, std::string& out) {
+		if (cp < 0x80) {
+			out += static_cast<char>(cp);
+		} else if (cp < 0x800) {
+			out += static_cast<char>(0xC0 | (cp >> 6));
+			out += static_cast<char>(0x80 | (cp & 0x3F));
+		} else if (cp < 0x10000) {
+			out += static_cast<char>(0xE0 | (cp >> 12));
+			out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+			out += static_cast<char>(0x80 | (cp & 0x3F));
+		} else {
+			out += static_cast<char>(0xF0 | (cp >> 18));
+			out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+			out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+			out += static_cast<char>(0x80 | (cp & 0x3F));
+		}
+	}
+
+	// The composite of `starter` followed by `mark`, or 0 when they don't compose
+	char32_t compose(char32_t starter, char32_t mark) {
+		if (starter >= HANGUL_L and starter < HANGUL_L + HANGUL_L_COUNT and mark >= HANGUL_V and mark < HANGUL_V + HANGUL_V_COUNT)
+			return HANGUL_S + ((starter - HANGUL_L) * HANGUL_V_COUNT + (mark - HANGUL_V)) * HANGUL_T_COUNT;
+		if (starter >= HANGUL_S and starter < HANGUL_S + HANGUL_L_COUNT * HANGUL_N_COUNT and (starter - HANGUL_S) % HANGUL_T_COUNT == 0
+			and mark > HANGUL_T and mark < HANGUL_T + HANGUL_T_COUNT)
+			return starter + (mark - HANGUL_T);
+
+		auto it = std::lower_bound(std::begin(COMPOSITIONS), std::end(COMPOSITIONS), Composition{ starter, mark, 0 },
+			[](const Composition& a, const Composition& b) { return a.starter != b.starter ? a.starter < b.starter : a.mark < b.mark; });
+		return it != std::end(COMPOSITIONS) and it->starter == starter and it->mark == mark ? it->composite : 0;
+	}
+
+	void fold(char32_t cp, std::string& out) {
+		auto special = std::lower_bound(std::begin(FOLD_SPECIALS), std::end(FOLD_SPECIALS), cp,
+			[](const FoldSpecial& s, char32_t value) { return s.from < value; });
+		if (special != std::end(FOLD_SPECIALS) and special->from == cp) {
+			for (char32_t c : special->to)
+				if (c != 0)
+					encode(c, out);
+			return;
+		}
+
+		auto range = std::upper_bound(std::begin(FOLD_RANGES), std::end(FOLD_RANGES), cp,
+			[](char32_t value, const FoldRange& r) { return value < r.first; });
+		if (range != std::begin(FOLD_RANGES)) {
+			--range;
+			if (cp <= range->last and (cp - range->first) % range->stride == 0)
+				cp = static_cast<char32_t>(static_cast<int32_t>(cp) + range->delta);
+		}
+		encode(cp, out);
+	}
+}
+
+
+std::string Unicode::match_key(std::string_view text) {
+	std::string key;
+	key.reserve(text.size());
+
+	// Almost every directory name is ASCII, which needs none of the tables
+	if (std::all_of(text.begin(), text.end(), [](char c) { return static_cast<unsigned char>(c) < 0x80; })) {
+		for (char c : text) {
+			if (is_separator(c))
+				continue;
+			key += c >= 'A' and c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+		}
+		return key;
+	}
+
+	// Compose first (folding can change what composes), then fold each composed code point
+	std::vector<char32_t> composed;
+	std::vector<bool> raw;
+	for (size_t i = 0; i < text.size();) {
+		bool valid = true;
+		char32_t cp = decode(text, i, valid);
+		char32_t composite = valid and not composed.empty() and not raw.back() ? compose(composed.back(), cp) : 0;
+		if (composite != 0) {
+			composed.back() = composite;
+		} else {
+			composed.push_back(cp);
+			raw.push_back(not valid);
+		}
+	}
+
+	for (size_t i = 0; i < composed.size(); i++) {
+		if (raw[i])
+			key += static_cast<char>(composed[i]);
+		else if (not is_separator(composed[i]))
+			fold(composed[i], key);
+	}
+	return key;
+}
@@ -1,51 +1,91 @@
+#include "Daemon.h"
 #include "Database.h"
 #include "Handler.h"
 #include "Helpers.h"
+#include "RequestGeneration.h"
+#include "StdioServer.h"
+
+#include <optional>
 
 #ifndef DIRVANA_VERSION
 #define DIRVANA_VERSION "dev"
 #endif
 
+// Subcommands that rewrite the database or the user's shell config run in-process so they
+// never tie up the daemon that serves completions
+static bool should_forward(int argc, char* argv[]) {
+	static constexpr auto local_only = make_static_set({ "build", "rebuild", "refresh", "init", "install" });
+	std::string_view call_type = argv[1];
+	if (call_type == "--tab" or call_type == "--tab0")
+		return true;
+	return call_type == "--enter" and not (argc > 3 and local_only.contains(argv[3]));
+}
+
+// Requests that only read the database open it read-only so they never take the write lock
+static bool is_query_only(int argc, char* argv[]) {
+	std::string_view call_type = argv[1];
+	if (call_type == "--tab" or call_type == "--tab0")
+		return true;
+	int first = call_type == "--enter" ? 3 : 1;
+	if (argc <= first)
+		return false;
+	std::string_view first_token = argv[first];
+	return first_token == "--version" or first_token == "-v" or first_token == "--cache-stats" or first_token == "list" or first_token == "show";
+}
+
+// With DIRVANA_TIMINGS set, report when each phase of an in-process call finished so bench_e2e can
+// split the latency it measures from outside: entry, config loaded, database open, handled, output flushed
+static void report_timings(const long long (&marks)[5]) {
+	if (std::getenv("DIRVANA_TIMINGS") == nullptr)
+		return;
+	std::cerr << "dirvana-timings";
+	for (long long mark : marks)
+		std::cerr << " " << mark;
+	std::cerr << std::endl;
+}
+
 int main(int argc, char* argv[]) {
+	long long marks[5] = { Time::monotonic_ns() };
 
-	// Initialize the database
-	Config config;
-	Database db(config);
-	Handler handler(db, DIRVANA_VERSION);
+	// std::cout keeps its own buffer instead of going through stdio, so a response leaves in one write at the final flush
+	std::ios::sync_with_stdio(false);
 
-	// Need at least 2 arguments: program name and a flag
-	if (argc < 2) {
-		std::cerr << "Usage: " << argv[0] << " [--tab|--enter] dv [command] [path]" << std::endl;
-		return 1;
-	}
+	// Completions started by fast typing are abandoned as soon as a newer one starts on the same terminal,
+	// so claim a generation before doing any work, including handing the request to the daemon
+	std::optional<RequestGeneration> generation;
+	if (argc >= 2 and (std::string_view(argv[1]) == "--tab" or std::string_view(argv[1]) == "--tab0"))
+		generation.emplace(RequestGeneration::tty_key());
 
-	std::string call_type = argc > 1 ? argv[1] : "";
+	// Hand the request to a running daemon if there is one; otherwise answer it in-process
+	int status = 0;
+	if (argc >= 2 and should_forward(argc, argv) and
+			Daemon::forward(argc, argv, DIRVANA_VERSION, status, generation ? &*generation : nullptr))
+		return status;
 
-	// Handle tab completion
-	if (call_type == "--tab") {
-		return handler.handle_tab(argc, argv);
+	if (argc >= 2 and std::string_view(argv[1]) == "daemon") {
+		if (argc > 2 and std::string_view(argv[2]) == "stop")
+			return Daemon::forward(argc, argv, DIRVANA_VERSION, status) ? status : 1;
+		return Daemon(DIRVANA_VERSION).serve();
 	}
 
-	// Direct subcommand invocation (e.g. `dv-binary init`) — used before the dv() shell function
-	// is available. Synthesize the `--enter dv` prefix so process_args sees the expected structure.
-	std::vector<std::string> wrapped_storage;
-	std::vector<char*> wrapped_argv;
-	int effective_argc = argc;
-	char** effective_argv = argv;
-	if (call_type != "--enter") {
-		wrapped_storage.reserve(argc + 2);
-		wrapped_storage.push_back(argv[0]);
-		wrapped_storage.push_back("--enter");
-		wrapped_storage.push_back("dv");
-		for (int i = 1; i < argc; i++) wrapped_storage.push_back(argv[i]);
-		for (auto& s : wrapped_storage) wrapped_argv.push_back(s.data());
-		effective_argc = wrapped_argv.size();
-		effective_argv = wrapped_argv.data();
-	}
+	// Initialize the database
+	Config config;
+	marks[1] = Time::monotonic_ns();
+	Database db(config, argc >= 2 and is_query_only(argc, argv));
+	marks[2] = Time::monotonic_ns();
+	Handler handler(db, DIRVANA_VERSION);
+	if (generation)
+		db.set_abort_check([&generation] { return generation->superseded(); });
+
+	// Keep this process around and answer requests from stdin until it is closed
+	if (argc >= 2 and std::string_view(argv[1]) == "--serve-stdio")
+		return StdioServer(handler, argc > 2 and std::string_view(argv[2]) == "-0").serve(std::cin, std::cout);
 
-	auto [valid, commands, flags] = ArgParsing::process_args(effective_argc, effective_argv);
-	if (!valid)
-		return 1;
+	status = handler.handle_call(argc, argv);
+	marks[3] = Time::monotonic_ns();
+	std::cout.flush();
+	marks[4] = Time::monotonic_ns();
 
-	return handler.handle_enter(commands, flags);
-}
\ No newline at end of file
+	report_timings(marks);
+	return status;
+}
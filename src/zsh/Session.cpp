@@ -0,0 +1,66 @@
+#include "Session.h"
+#include "Handler.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <sstream>
+
+#ifndef DIRVANA_VERSION
+#define DIRVANA_VERSION "dev"
+#endif
+
+// One session per shell; zsh builtins never run concurrently
+static std::unique_ptr<Config> config;
+static std::unique_ptr<Database> db;
+static std::unique_ptr<Handler> handler;
+static std::filesystem::file_time_type config_mtime;
+
+static void reload_if_stale() {
+	// Pick up edits to config.json without requiring the shell to reload the module
+	std::error_code ec;
+	if (config) {
+		auto mtime = std::filesystem::last_write_time(config->get_config_path(), ec);
+		if (!ec and mtime == config_mtime)
+			return;
+	}
+
+	handler.reset();
+	db.reset();
+	config = std::make_unique<Config>();
+	db = std::make_unique<Database>(*config);
+	handler = std::make_unique<Handler>(*db, DIRVANA_VERSION);
+	config_mtime = std::filesystem::last_write_time(config->get_config_path(), ec);
+}
+
+
+extern "C" int dv_session_call(int argc, char** argv, char** out, size_t* out_len) {
+	// Collect what the handler prints so it can be handed back to the shell
+	std::ostringstream captured;
+	int status = 1;
+	try {
+		reload_if_stale();
+		status = handler->handle_call(argc, argv, captured);
+	} catch (const std::exception& e) {
+		std::cerr << "dirvana: " << e.what() << std::endl;
+	}
+
+	// Exceptions must not cross into zsh, so allocation failure is reported as an empty result
+	std::string result = captured.str();
+	*out_len = result.size();
+	*out = static_cast<char*>(std::malloc(result.size() + 1));
+	if (*out == nullptr) {
+		*out_len = 0;
+		return 1;
+	}
+	std::memcpy(*out, result.c_str(), result.size() + 1);
+	return status;
+}
+
+
+extern "C" void dv_session_close(void) {
+	handler.reset();
+	db.reset();
+	config.reset();
+}
@@ -0,0 +1,21 @@
+#ifndef DIRVANA_ZSH_SESSION_H
+#define DIRVANA_ZSH_SESSION_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Runs argv through the Handler of a Config/Database/Handler set that stays open until
+// dv_session_close(). Whatever the handler prints is returned in a malloc'ed buffer in *out
+// (the caller frees it) and the handler's exit status is returned.
+int dv_session_call(int argc, char** argv, char** out, size_t* out_len);
+
+void dv_session_close(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DIRVANA_ZSH_SESSION_H
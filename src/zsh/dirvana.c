@@ -0,0 +1,150 @@
+/*
+ * dirvana zsh module: `zmodload dirvana` adds the dv_complete and dv_enter builtins, which answer
+ * completion and navigation requests inside the shell instead of running dv-binary in a subshell.
+ *
+ *   dv_complete dv [words...] partial   sets $reply to the completion candidates
+ *   dv_enter [words...]                 sets $REPLY to the command that dv should eval
+ */
+
+#include "zsh.mdh"
+#include "Session.h"
+
+#include <stdlib.h>
+
+/* Builds the argv the Handler expects from a prefix plus the (metafied) builtin arguments */
+static char **
+make_argv(char **prefix, int prefix_len, char **args, int *argc)
+{
+	int nargs = arrlen(args);
+	char **argv = (char **) zhalloc((prefix_len + nargs + 1) * sizeof(char *));
+	int i;
+
+	for (i = 0; i < prefix_len; i++)
+		argv[i] = prefix[i];
+	for (i = 0; i < nargs; i++)
+		argv[prefix_len + i] = unmetafy(dupstring(args[i]), NULL);
+	argv[prefix_len + nargs] = NULL;
+	*argc = prefix_len + nargs;
+	return argv;
+}
+
+/* Splits newline-separated output into a zalloc'ed, metafied array suitable for setaparam */
+static char **
+split_lines(const char *buf, size_t len)
+{
+	size_t count = 0, i, start;
+	char **lines;
+
+	for (i = 0; i < len; i++)
+		if (buf[i] == '\n')
+			count++;
+	if (len > 0 && buf[len - 1] != '\n')
+		count++;
+
+	lines = (char **) zshcalloc((count + 1) * sizeof(char *));
+	count = 0;
+	for (i = start = 0; i <= len; i++) {
+		if (i == len ? i > start : buf[i] == '\n') {
+			lines[count++] = metafy((char *) buf + start, (int) (i - start), META_DUP);
+			start = i + 1;
+		}
+	}
+	lines[count] = NULL;
+	return lines;
+}
+
+/**/
+static int
+bin_dv_complete(UNUSED(char *nam), char **args, UNUSED(Options ops), UNUSED(int func))
+{
+	char *prefix[] = { "dv-binary", "--tab" };
+	char *out;
+	size_t len;
+	int argc, status;
+	char **argv = make_argv(prefix, 2, args, &argc);
+
+	status = dv_session_call(argc, argv, &out, &len);
+	if (out == NULL)
+		return 1;
+	setaparam("reply", split_lines(out, len));
+	free(out);
+	return status;
+}
+
+/**/
+static int
+bin_dv_enter(UNUSED(char *nam), char **args, UNUSED(Options ops), UNUSED(int func))
+{
+	char *prefix[] = { "dv-binary", "--enter", "dv" };
+	char *out;
+	size_t len;
+	int argc, status;
+	char **argv = make_argv(prefix, 3, args, &argc);
+
+	status = dv_session_call(argc, argv, &out, &len);
+	if (out == NULL)
+		return 1;
+	while (len > 0 && out[len - 1] == '\n')
+		len--;
+	setsparam("REPLY", metafy(out, (int) len, META_DUP));
+	free(out);
+	return status;
+}
+
+/* No option parsing (optstr is NULL) so flags like -v reach the Handler untouched */
+static struct builtin bintab[] = {
+	BUILTIN("dv_complete", 0, bin_dv_complete, 1, -1, 0, NULL, NULL),
+	BUILTIN("dv_enter", 0, bin_dv_enter, 0, -1, 0, NULL, NULL),
+};
+
+static struct features module_features = {
+	bintab, sizeof(bintab) / sizeof(*bintab),
+	NULL, 0,
+	NULL, 0,
+	NULL, 0,
+	0
+};
+
+/**/
+int
+setup_(UNUSED(Module m))
+{
+	return 0;
+}
+
+/**/
+int
+features_(Module m, char ***features)
+{
+	*features = featuresarray(m, &module_features);
+	return 0;
+}
+
+/**/
+int
+enables_(Module m, int **enables)
+{
+	return handlefeatures(m, &module_features, enables);
+}
+
+/**/
+int
+boot_(UNUSED(Module m))
+{
+	return 0;
+}
+
+/**/
+int
+cleanup_(Module m)
+{
+	return setfeatureenables(m, &module_features, NULL);
+}
+
+/**/
+int
+finish_(UNUSED(Module m))
+{
+	dv_session_close();
+	return 0;
+}
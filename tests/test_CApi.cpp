@@ -0,0 +1,163 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <filesystem>
+#include <thread>
+
+#include "dirvana.h"
+#include "Database.h"
+#include "utils/TempConfigFile.hpp"
+
+using namespace std;
+using ConfigArgs = TempConfigFile::Args;
+
+class CApiTest : public ::testing::Test {
+protected:
+	void SetUp() override {
+		ConfigArgs args;
+		args.db_path = (filesystem::temp_directory_path() / "dirvana_capi_test.db").string();
+		filesystem::remove(args.db_path);
+		temp_config = make_unique<TempConfigFile>(args);
+		{
+			Config config(temp_config->get_path());
+			Database db(config);
+			db.build(config.get_init_path());
+			mockfs = config.get_init_path();
+			db_path = config.get_db_path();
+		}
+	}
+	void TearDown() override {
+		temp_config.reset();
+		filesystem::remove(db_path);
+	}
+
+	// Unpacks the NUL-separated results written by dv_query
+	static vector<string> unpack(const char* buffer, size_t used) {
+		vector<string> results;
+		for (const char* p = buffer; p < buffer + used; p += strlen(p) + 1)
+			results.emplace_back(p);
+		return results;
+	}
+
+	string mockfs;
+	string db_path;
+	unique_ptr<TempConfigFile> temp_config;
+};
+
+TEST_F(CApiTest, QueryFillsCallerBuffer) {
+	dv_handle* dv = dv_open(temp_config->get_path().c_str(), DV_OPEN_READ_ONLY);
+	ASSERT_NE(dv, nullptr);
+
+	char buffer[4096];
+	size_t used = 0, count = 0;
+	ASSERT_EQ(dv_query(dv, "1", buffer, sizeof(buffer), &used, &count), DV_OK);
+	vector<string> results = unpack(buffer, used);
+	EXPECT_EQ(results.size(), count);
+	EXPECT_NE(find(results.begin(), results.end(), mockfs + "/1"), results.end());
+	dv_close(dv);
+}
+
+// Abbreviated paths expand as they do on Tab
+TEST_F(CApiTest, QueryExpandsAbbreviatedPath) {
+	dv_handle* dv = dv_open(temp_config->get_path().c_str(), DV_OPEN_READ_ONLY);
+	ASSERT_NE(dv, nullptr);
+
+	char buffer[4096];
+	size_t used = 0, count = 0;
+	ASSERT_EQ(dv_query(dv, (mockfs + "/1/1/1/4").c_str(), buffer, sizeof(buffer), &used, &count), DV_OK);
+	vector<string> results = unpack(buffer, used);
+	ASSERT_FALSE(results.empty());
+	EXPECT_EQ(results[0], mockfs + "/1/1/1/4");
+	dv_close(dv);
+}
+
+TEST_F(CApiTest, QueryReportsNeededSize) {
+	dv_handle* dv = dv_open(temp_config->get_path().c_str(), DV_OPEN_READ_ONLY);
+	ASSERT_NE(dv, nullptr);
+
+	char buffer[1];
+	size_t used = 0, count = 0;
+	EXPECT_EQ(dv_query(dv, "1", buffer, sizeof(buffer), &used, &count), DV_BUFFER_TOO_SMALL);
+	EXPECT_GT(used, sizeof(buffer));
+	EXPECT_GT(count, 0u);
+	dv_close(dv);
+}
+
+TEST_F(CApiTest, ReadOnlyHandleRejectsWrites) {
+	dv_handle* dv = dv_open(temp_config->get_path().c_str(), DV_OPEN_READ_ONLY);
+	ASSERT_NE(dv, nullptr);
+	EXPECT_EQ(dv_access(dv, (mockfs + "/1").c_str()), DV_READ_ONLY);
+	EXPECT_EQ(dv_refresh(dv, nullptr), DV_READ_ONLY);
+	dv_close(dv);
+}
+
+// Creating or migrating the database needs a writable connection, but the handle stays read-only
+TEST_F(CApiTest, ReadOnlyHandleStaysReadOnlyAfterMigration) {
+	{
+		Config config(temp_config->get_path());
+		Database db(config);
+		db << "PRAGMA user_version = 1;";
+	}
+	dv_handle* dv = dv_open(temp_config->get_path().c_str(), DV_OPEN_READ_ONLY);
+	ASSERT_NE(dv, nullptr);
+	EXPECT_EQ(dv_access(dv, (mockfs + "/1").c_str()), DV_READ_ONLY);
+	dv_close(dv);
+
+	filesystem::remove(db_path);
+	dv = dv_open(temp_config->get_path().c_str(), DV_OPEN_READ_ONLY);
+	ASSERT_NE(dv, nullptr);
+	EXPECT_EQ(dv_refresh(dv, nullptr), DV_READ_ONLY);
+	dv_close(dv);
+}
+
+TEST_F(CApiTest, AccessReportsFailure) {
+	dv_handle* dv = dv_open(temp_config->get_path().c_str(), 0);
+	ASSERT_NE(dv, nullptr);
+
+	// Another process holds the write lock past the busy timeout
+	sqlite::database other(db_path);
+	other << "BEGIN IMMEDIATE;";
+	testing::internal::CaptureStderr();
+	EXPECT_EQ(dv_access(dv, (mockfs + "/1").c_str()), DV_ERROR);
+	testing::internal::GetCapturedStderr();
+	EXPECT_NE(string(dv_last_error()).find(mockfs + "/1"), string::npos);
+	other << "ROLLBACK;";
+	dv_close(dv);
+}
+
+TEST_F(CApiTest, AccessPromotesPath) {
+	dv_handle* dv = dv_open(temp_config->get_path().c_str(), 0);
+	ASSERT_NE(dv, nullptr);
+
+	char buffer[4096];
+	size_t used = 0, count = 0;
+	ASSERT_EQ(dv_query(dv, "1", buffer, sizeof(buffer), &used, &count), DV_OK);
+	vector<string> before = unpack(buffer, used);
+	ASSERT_GT(before.size(), 1u);
+
+	ASSERT_EQ(dv_access(dv, before.back().c_str()), DV_OK);
+	ASSERT_EQ(dv_query(dv, "1", buffer, sizeof(buffer), &used, &count), DV_OK);
+	EXPECT_EQ(unpack(buffer, used).front(), before.back());
+	dv_close(dv);
+}
+
+TEST_F(CApiTest, ConcurrentQueriesOnOneHandle) {
+	dv_handle* dv = dv_open(temp_config->get_path().c_str(), DV_OPEN_READ_ONLY);
+	ASSERT_NE(dv, nullptr);
+
+	vector<thread> threads;
+	atomic<int> failures = 0;
+	for (int t = 0; t < 4; t++) {
+		threads.emplace_back([&] {
+			char buffer[4096];
+			size_t used, count;
+			for (int i = 0; i < 50; i++)
+				if (dv_query(dv, "1", buffer, sizeof(buffer), &used, &count) != DV_OK or count == 0)
+					failures++;
+		});
+	}
+	for (auto& t : threads)
+		t.join();
+	EXPECT_EQ(failures, 0);
+	dv_close(dv);
+}
@@ -0,0 +1,62 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+
+#include "Config.h"
+#include "utils/TempConfigFile.hpp"
+
+using namespace std;
+using ConfigArgs = TempConfigFile::Args;
+
+TEST(Config, ReadsValues) {
+	TempConfigFile temp_config{ ConfigArgs{ .max_results = 7, .match_type = "prefix", .promotion_strategy = "frequency_based" } };
+	Config config(temp_config.path);
+	EXPECT_EQ(config.get_max_results(), 7);
+	EXPECT_EQ(config.get_matching_type(), MatchingType::Prefix);
+	EXPECT_EQ(config.get_promotion_strategy(), PromotionStrategy::FREQUENCY_BASED);
+	EXPECT_EQ(config.get_exclusion_rules().size(), 2u);
+}
+
+TEST(Config, WritesSnapshotCache) {
+	TempConfigFile temp_config{ ConfigArgs{} };
+	filesystem::remove(temp_config.path + ".cache");
+	Config config(temp_config.path);
+	EXPECT_TRUE(filesystem::exists(temp_config.path + ".cache"));
+}
+
+// While config.json keeps its mtime and size, the snapshot is used and the JSON is never parsed
+TEST(Config, SnapshotSkipsParsing) {
+	TempConfigFile temp_config{ ConfigArgs{ .max_results = 7 } };
+	{ Config config(temp_config.path); }
+
+	auto mtime = filesystem::last_write_time(temp_config.path);
+	auto size = filesystem::file_size(temp_config.path);
+	{
+		ofstream out(temp_config.path, ios::trunc);
+		out << string(size, ' ');
+	}
+	filesystem::last_write_time(temp_config.path, mtime);
+
+	testing::internal::CaptureStderr();
+	Config config(temp_config.path);
+	EXPECT_EQ(testing::internal::GetCapturedStderr(), "");
+	EXPECT_EQ(config.get_max_results(), 7);
+}
+
+TEST(Config, SnapshotInvalidatedOnChange) {
+	TempConfigFile temp_config{ ConfigArgs{ .max_results = 7 } };
+	{ Config config(temp_config.path); }
+
+	TempConfigFile changed{ ConfigArgs{ .max_results = 25, .match_type = "suffix" } };
+	Config config(changed.path);
+	EXPECT_EQ(config.get_max_results(), 25);
+	EXPECT_EQ(config.get_matching_type(), MatchingType::Suffix);
+}
+
+TEST(Config, InvalidValuesAreRepaired) {
+	TempConfigFile temp_config{ ConfigArgs{ .max_results = -3, .match_type = "bogus" } };
+	Config config(temp_config.path);
+	EXPECT_EQ(config.get_max_results(), 10);
+	EXPECT_EQ(config.get_matching_type(), MatchingType::Contains);
+}
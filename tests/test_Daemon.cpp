@@ -0,0 +1,156 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "Daemon.h"
+#include "utils/TempConfigFile.hpp"
+
+using namespace std;
+using ConfigArgs = TempConfigFile::Args;
+
+class DaemonTest : public ::testing::Test {
+protected:
+	void SetUp() override {
+		runtime_dir = filesystem::temp_directory_path() / "dirvana_daemon_test";
+		filesystem::create_directories(runtime_dir);
+		setenv("XDG_RUNTIME_DIR", runtime_dir.c_str(), 1);
+
+		ConfigArgs args;
+		args.db_path = (filesystem::temp_directory_path() / "dirvana_daemon_test.db").string();
+		filesystem::remove(args.db_path);
+		temp_config = make_unique<TempConfigFile>(args);
+		{
+			Config config(temp_config->get_path());
+			Database db(config);
+			db.build(config.get_init_path());
+			mockfs = config.get_init_path();
+			db_path = config.get_db_path();
+		}
+
+		daemon = make_unique<Daemon>("test", temp_config->get_path());
+		server = thread([this] { daemon->serve(); });
+		for (int i = 0; i < 200 and not filesystem::exists(Daemon::socket_path()); i++)
+			this_thread::sleep_for(chrono::milliseconds(5));
+	}
+	void TearDown() override {
+		if (server.joinable()) {
+			int status = 0;
+			vector<const char*> stop = {"dv-binary", "daemon", "stop"};
+			Daemon::forward(stop.size(), const_cast<char**>(stop.data()), "test", status);
+			server.join();
+		}
+		daemon.reset();
+		temp_config.reset();
+		filesystem::remove(db_path);
+		filesystem::remove_all(runtime_dir);
+		unsetenv("XDG_RUNTIME_DIR");
+	}
+
+	// Forwards argv to the daemon and returns {answered, status, stdout}
+	tuple<bool, int, string> forward(vector<const char*> args, const string& version = "test",
+			const RequestGeneration* generation = nullptr) {
+		int status = -1;
+		testing::internal::CaptureStdout();
+		bool answered = Daemon::forward(args.size(), const_cast<char**>(args.data()), version, status, generation);
+		return {answered, status, testing::internal::GetCapturedStdout()};
+	}
+
+	// Sends a raw request, so it can claim a working directory this process isn't in, and returns the reply
+	string send_raw(const string& request) {
+		struct sockaddr_un addr = {};
+		addr.sun_family = AF_UNIX;
+		strncpy(addr.sun_path, Daemon::socket_path().c_str(), sizeof(addr.sun_path) - 1);
+		int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		string reply;
+		if (connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0 and
+				write(fd, request.data(), request.size()) == static_cast<ssize_t>(request.size()) and shutdown(fd, SHUT_WR) == 0) {
+			char buffer[4096];
+			for (ssize_t n; (n = read(fd, buffer, sizeof(buffer))) > 0;)
+				reply.append(buffer, n);
+		}
+		close(fd);
+		return reply;
+	}
+
+	filesystem::path runtime_dir;
+	string mockfs;
+	string db_path;
+	unique_ptr<TempConfigFile> temp_config;
+	unique_ptr<Daemon> daemon;
+	thread server;
+};
+
+TEST_F(DaemonTest, AnswersTabCompletion) {
+	auto [answered, status, output] = forward({"dv-binary", "--tab", "dv", "1"});
+	EXPECT_TRUE(answered);
+	EXPECT_EQ(status, 0);
+	EXPECT_NE(output.find(mockfs + "/1\n"), string::npos);
+}
+
+TEST_F(DaemonTest, AnswersEnter) {
+	auto [answered, status, output] = forward({"dv-binary", "--enter", "dv", "/tmp"});
+	EXPECT_TRUE(answered);
+	EXPECT_EQ(status, 0);
+	EXPECT_EQ(output, "cd /tmp\n");
+}
+
+// A completion queued behind others is dropped once a newer one started on its terminal
+TEST_F(DaemonTest, DropsSupersededCompletion) {
+	RequestGeneration older("pts_daemon");
+	auto [answered, status, output] = forward({"dv-binary", "--tab", "dv", "1"}, "test", &older);
+	EXPECT_TRUE(answered);
+	EXPECT_EQ(status, 0);
+	EXPECT_FALSE(output.empty());
+
+	RequestGeneration newer("pts_daemon");
+	tie(answered, status, output) = forward({"dv-binary", "--tab", "dv", "1"}, "test", &older);
+	EXPECT_TRUE(answered);
+	EXPECT_EQ(status, 1);
+	EXPECT_TRUE(output.empty());
+}
+
+// Relative partials are completed from the client's working directory, not the daemon's
+TEST_F(DaemonTest, CompletesRelativeToClientDirectory) {
+	string cwd = filesystem::current_path().string();
+	string request = string("test") + '\0' + TEST_SOURCE_DIR + '\0' + '\0' + '\0' + "--tab" + '\0' + "dv" + '\0' + "mockfs/" + '\0';
+	string reply = send_raw(request);
+	ASSERT_FALSE(reply.empty());
+	EXPECT_EQ(reply[0], 0);
+	EXPECT_EQ(reply.substr(1), string("0") + '\0' + "mockfs/file\n");
+	EXPECT_EQ(filesystem::current_path().string(), cwd);
+}
+
+// Diagnostics reach the client's stderr, not the daemon's
+TEST_F(DaemonTest, RelaysErrors) {
+	testing::internal::CaptureStderr();
+	auto [answered, status, output] = forward({"dv-binary", "--enter", "dv", "show", "missing"});
+	string errors = testing::internal::GetCapturedStderr();
+	EXPECT_TRUE(answered);
+	EXPECT_EQ(status, 1);
+	EXPECT_TRUE(output.empty());
+	EXPECT_EQ(errors, "Shortcut missing not found\n");
+}
+
+// A client built from a different version must fall back to in-process handling
+TEST_F(DaemonTest, RejectsVersionMismatch) {
+	auto [answered, status, output] = forward({"dv-binary", "--tab", "dv", "1"}, "other");
+	EXPECT_FALSE(answered);
+	EXPECT_TRUE(output.empty());
+	server.join();
+}
+
+TEST(Daemon, ForwardWithoutDaemon) {
+	setenv("XDG_RUNTIME_DIR", filesystem::temp_directory_path().c_str(), 1);
+	filesystem::remove(Daemon::socket_path());
+	int status = -1;
+	vector<const char*> args = {"dv-binary", "--tab", "dv", "1"};
+	EXPECT_FALSE(Daemon::forward(args.size(), const_cast<char**>(args.data()), "test", status));
+	unsetenv("XDG_RUNTIME_DIR");
+}
@@ -150,4 +150,450 @@ TEST_F(DatabaseTest, AccessDatabase) {
 
 	EXPECT_NO_THROW(db->get_paths_table().access(config->get_init_path() + "/1"));
 	ordered_check(config->get_init_path(), db->get_paths_table().query("1"), {"/1", "/1/1", "/1/1/1"});
-}
\ No newline at end of file
+}
+TEST_F(DatabaseTest, SchemaVersion) {
+	EXPECT_NO_THROW(db = make_unique<Database>(*config));
+	EXPECT_FALSE(db->is_read_only());
+
+	int version = 0;
+	*db << "PRAGMA user_version;" >> version;
+	EXPECT_EQ(version, Database::SCHEMA_VERSION);
+}
+
+TEST_F(DatabaseTest, ReadOnlyQuery) {
+	// Create and populate the database read-write first
+	EXPECT_NO_THROW(db = make_unique<Database>(*config));
+	EXPECT_NO_THROW(db->build(config->get_init_path()));
+	db.reset();
+
+	EXPECT_NO_THROW(db = make_unique<Database>(*config, true));
+	EXPECT_TRUE(db->is_read_only());
+	unordered_check(config->get_init_path(), db->get_paths_table().query("1"), {"/1", "/1/1", "/1/1/1"});
+}
+
+TEST_F(DatabaseTest, ReadOnlyCreatesMissingDatabase) {
+	// A read-only open of a database that doesn't exist yet creates it first, then goes back to reading
+	EXPECT_NO_THROW(db = make_unique<Database>(*config, true));
+	EXPECT_TRUE(db->is_read_only());
+	EXPECT_TRUE(db->get_paths_table().query("1").empty());
+}
+
+TEST_F(DatabaseTest, ContainsMatchesThroughTrigramIndex) {
+	config->set_exclusion_rules({});
+	config->set_matching_type("contains");
+	EXPECT_NO_THROW(db = make_unique<Database>(*config));
+	EXPECT_NO_THROW(db->build(config->get_init_path()));
+
+	// Separators aren't part of the key, so "x_check" looks for "xcheck"
+	unordered_check(config->get_init_path(), db->get_paths_table().query("x_check"), {
+		"/custom_rule_check/prefix_check",
+		"/custom_rule_check/suffix_check"
+	});
+	// Keys shorter than a trigram fall back to the scan
+	unordered_check(config->get_init_path(), db->get_paths_table().query("t_c"), {
+		"/custom_rule_check/exact_check",
+		"/custom_rule_check/.dot_check"
+	});
+	// Case-insensitive like LIKE
+	unordered_check(config->get_init_path(), db->get_paths_table().query("PREFIX"), { "/custom_rule_check/prefix_check" });
+}
+
+TEST_F(DatabaseTest, TrigramIndexFollowsDeletes) {
+	config->set_exclusion_rules({});
+	config->set_matching_type("contains");
+	EXPECT_NO_THROW(db = make_unique<Database>(*config));
+	EXPECT_NO_THROW(db->build(config->get_init_path()));
+
+	db->get_paths_table().delete_paths({ config->get_init_path() + "/custom_rule_check/prefix_check" });
+	unordered_check(config->get_init_path(), db->get_paths_table().query("fix"), { "/custom_rule_check/suffix_check" });
+}
+
+TEST_F(DatabaseTest, MigrationRebuildsTrigramIndex) {
+	config->set_exclusion_rules({});
+	config->set_matching_type("contains");
+	EXPECT_NO_THROW(db = make_unique<Database>(*config));
+	EXPECT_NO_THROW(db->build(config->get_init_path()));
+
+	// Make the database look like it was written by schema version 1, before the trigram index existed
+	*db << "DROP TABLE paths_trigram;";
+	*db << "DROP TRIGGER paths_trigram_insert;";
+	*db << "DROP TRIGGER paths_trigram_delete;";
+	*db << "DROP TRIGGER paths_trigram_update;";
+	*db << "PRAGMA user_version = 1;";
+	db.reset();
+
+	EXPECT_NO_THROW(db = make_unique<Database>(*config, true));
+	unordered_check(config->get_init_path(), db->get_paths_table().query("fix"), {
+		"/custom_rule_check/prefix_check",
+		"/custom_rule_check/suffix_check"
+	});
+	EXPECT_TRUE(db->is_read_only());
+	db.reset();
+
+	// Schema version 6 indexed dir_name itself rather than its match key
+	EXPECT_NO_THROW(db = make_unique<Database>(*config));
+	*db << "DROP TABLE paths_trigram;";
+	*db << "CREATE VIRTUAL TABLE paths_trigram USING fts5(dir_name, content='paths', content_rowid='id', tokenize='trigram');";
+	*db << "PRAGMA user_version = 6;";
+	db.reset();
+
+	EXPECT_NO_THROW(db = make_unique<Database>(*config, true));
+	unordered_check(config->get_init_path(), db->get_paths_table().query("fix-check"), {
+		"/custom_rule_check/prefix_check",
+		"/custom_rule_check/suffix_check"
+	});
+}
+
+// A migration that can't finish leaves the schema version alone, so the next open tries again
+TEST_F(DatabaseTest, FailedMigrationIsRetried) {
+	EXPECT_NO_THROW(db = make_unique<Database>(*config));
+	EXPECT_NO_THROW(db->build(config->get_init_path()));
+	*db << "DROP TABLE path_components;";
+	*db << "PRAGMA user_version = 1;";
+	db.reset();
+
+	// Another process holds the write lock past the busy timeout
+	sqlite::database other(config->get_db_path());
+	other << "BEGIN IMMEDIATE;";
+	testing::internal::CaptureStderr();
+	EXPECT_NO_THROW(db = make_unique<Database>(*config));
+	EXPECT_NE(testing::internal::GetCapturedStderr().find("Error migrating database"), string::npos);
+	int version = 0;
+	*db << "PRAGMA user_version;" >> version;
+	EXPECT_EQ(version, 1);
+	other << "ROLLBACK;";
+	db.reset();
+
+	EXPECT_NO_THROW(db = make_unique<Database>(*config));
+	*db << "PRAGMA user_version;" >> version;
+	EXPECT_EQ(version, Database::SCHEMA_VERSION);
+	int tables = 0;
+	*db << "SELECT COUNT(*) FROM sqlite_master WHERE name = 'path_components';" >> tables;
+	EXPECT_EQ(tables, 1);
+}
+
+TEST_F(DatabaseTest, SuffixMatchesThroughReversedKey) {
+	config->set_exclusion_rules({});
+	config->set_matching_type("suffix");
+	EXPECT_NO_THROW(db = make_unique<Database>(*config));
+	EXPECT_NO_THROW(db->build(config->get_init_path()));
+
+	// Case- and separator-insensitive
+	vector<string> expected = {
+		"/custom_rule_check/prefix_check",
+		"/custom_rule_check/suffix_check"
+	};
+	unordered_check(config->get_init_path(), db->get_paths_table().query("FIX_CHECK"), expected);
+	unordered_check(config->get_init_path(), db->get_paths_table().query("fix_check"), expected);
+	unordered_check(config->get_init_path(), db->get_paths_table().query("ix_check"), expected);
+	EXPECT_TRUE(db->get_paths_table().query("ix_chec").empty());
+}
+
+TEST_F(DatabaseTest, PrefixMatchesThroughFoldedKey) {
+	config->set_exclusion_rules({});
+	config->set_matching_type("prefix");
+	EXPECT_NO_THROW(db = make_unique<Database>(*config));
+	EXPECT_NO_THROW(db->build(config->get_init_path()));
+
+	// Case- and separator-insensitive
+	vector<string> expected = {
+		"/custom_rule_check",
+		"/custom_rule_check/contains_check"
+	};
+	unordered_check(config->get_init_path(), db->get_paths_table().query("C"), expected);
+	unordered_check(config->get_init_path(), db->get_paths_table().query("CUSTOM"), { "/custom_rule_check" });
+	unordered_check(config->get_init_path(), db->get_paths_table().query("Custom-Rule"), { "/custom_rule_check" });
+	EXPECT_TRUE(db->get_paths_table().query("co_t").empty());
+	EXPECT_TRUE(db->get_paths_table().query("ustom").empty());
+}
+
+TEST_F(DatabaseTest, MatchesNormalizedKeys) {
+	EXPECT_NO_THROW(db = make_unique<Database>(*config));
+	// "Über" spelled decomposed, the way macOS stores names, next to separator variants of one name
+	db->get_paths_table().bulk_insert({
+		{ "/work/U\xcc\x88" "ber", "U\xcc\x88" "ber" },
+		{ "/work/my_service", "my_service" },
+		{ "/work/MyService", "MyService" },
+		{ "/work/other", "other" }
+	});
+
+	auto query = [&](const string& type, const string& needle) {
+		config->set_matching_type(type);
+		return db->get_paths_table().query(needle);
+	};
+	unordered_check("", query("exact", "\xc3\xbc" "ber"), { "/work/U\xcc\x88" "ber" });
+	unordered_check("", query("prefix", "\xc3\x9c" "B"), { "/work/U\xcc\x88" "ber" });
+	unordered_check("", query("contains", "y-serv"), { "/work/my_service", "/work/MyService" });
+	unordered_check("", query("suffix", "SERVICE"), { "/work/my_service", "/work/MyService" });
+
+	// The name as typed outranks its other spellings
+	auto results = query("exact", "MyService");
+	ASSERT_EQ(results.size(), 2u);
+	EXPECT_EQ(results[0], "/work/MyService");
+}
+
+TEST_F(DatabaseTest, MatchesInitialisms) {
+	EXPECT_NO_THROW(db = make_unique<Database>(*config));
+	db->get_paths_table().bulk_insert({
+		{ "/work/payment-gateway-service", "payment-gateway-service" },
+		{ "/work/PaymentGatewayAdapter", "PaymentGatewayAdapter" },
+		{ "/work/pga", "pga" },
+		{ "/work/pgadmin", "pgadmin" }
+	});
+
+	config->set_matching_type("contains");
+	unordered_check("", db->get_paths_table().query("pgs"), { "/work/payment-gateway-service" });
+	// Initialisms rank after the exact name and before names that merely contain the needle
+	EXPECT_EQ(db->get_paths_table().query("PGA"), vector<string>({ "/work/pga", "/work/PaymentGatewayAdapter", "/work/pgadmin" }));
+
+	// Exact mode only takes the name itself
+	config->set_matching_type("exact");
+	unordered_check("", db->get_paths_table().query("pgs"), {});
+}
+
+TEST_F(DatabaseTest, RegexMatches) {
+	config->set_exclusion_rules({});
+	config->set_matching_type("regex");
+	EXPECT_NO_THROW(db = make_unique<Database>(*config));
+	EXPECT_NO_THROW(db->build(config->get_init_path()));
+
+	// The trigram index picks the candidates ("check" is required), the regex decides
+	unordered_check(config->get_init_path(), db->get_paths_table().query("^(PRE|suf)fix_check$"), {
+		"/custom_rule_check/prefix_check",
+		"/custom_rule_check/suffix_check"
+	});
+	unordered_check(config->get_init_path(), db->get_paths_table().query("^\\.d"), { "/custom_rule_check/.dot_check" });
+	// No required literals at all still works, just without the index
+	EXPECT_FALSE(db->get_paths_table().query("^[0-9]$").empty());
+
+	testing::internal::CaptureStderr();
+	EXPECT_TRUE(db->get_paths_table().query("(unclosed").empty());
+	EXPECT_NE(testing::internal::GetCapturedStderr().find("Invalid regular expression"), string::npos);
+}
+
+TEST_F(DatabaseTest, StatementCacheReusesPlans) {
+	config->set_exclusion_rules({});
+	EXPECT_NO_THROW(db = make_unique<Database>(*config));
+	EXPECT_NO_THROW(db->build(config->get_init_path()));
+
+	// Repeating a query rebinds the statement it prepared the first time
+	auto first = db->get_paths_table().query("prefix_check");
+	size_t cached = db->cached_statements();
+	EXPECT_EQ(db->get_paths_table().query("prefix_check"), first);
+	EXPECT_EQ(db->get_paths_table().query("suffix_check").size(), 1u);
+	EXPECT_EQ(db->cached_statements(), cached);
+
+	// Another promotion strategy is another plan
+	config->set_promotion_strategy("frequency_based");
+	EXPECT_EQ(db->get_paths_table().query("prefix_check"), first);
+	EXPECT_GT(db->cached_statements(), cached);
+
+	// A statement that is still borrowed isn't handed out twice
+	auto outer = db->prepare("SELECT path FROM paths;");
+	auto inner = db->prepare("SELECT path FROM paths;");
+	ASSERT_TRUE(outer and inner);
+	EXPECT_NE(outer.get(), inner.get());
+
+	// Cached statements survive the table being dropped and rebuilt
+	outer = {};
+	inner = {};
+	EXPECT_NO_THROW(db->build(config->get_init_path(), true));
+	EXPECT_EQ(db->get_paths_table().query("prefix_check"), first);
+}
+
+TEST_F(DatabaseTest, PlansShortQueriesFromStats) {
+	config->set_exclusion_rules({});
+	config->set_matching_type("contains");
+	config->set_promotion_strategy("frequency_based");
+	EXPECT_NO_THROW(db = make_unique<Database>(*config));
+	EXPECT_NO_THROW(db->build(config->get_init_path()));
+
+	long long names = 0;
+	*db << "SELECT names FROM match_stats WHERE gram = X'23';" >> names;
+	EXPECT_EQ(names, static_cast<long long>(db->get_paths_table().count_existing_directories()));
+
+	db->get_paths_table().access(config->get_init_path() + "/custom_rule_check/exact_check");
+	db->get_paths_table().access(config->get_init_path() + "/custom_rule_check/exact_check");
+	db->get_paths_table().access(config->get_init_path() + "/custom_rule_check/prefix_check");
+
+	// Few slots and a common key: the rows are walked best first until the slots fill
+	config->set_max_results(2);
+	ordered_check(config->get_init_path(), db->get_paths_table().query("che"), {
+		"/custom_rule_check/exact_check",
+		"/custom_rule_check/prefix_check"
+	});
+
+	// Enough slots for every match: the matches are collected and sorted
+	config->set_max_results(10);
+	auto results = db->get_paths_table().query("ck");
+	ASSERT_EQ(results.size(), 6u);
+	EXPECT_EQ(results[0], config->get_init_path() + "/custom_rule_check/exact_check");
+	EXPECT_EQ(results[1], config->get_init_path() + "/custom_rule_check/prefix_check");
+
+	// Names equal to the key fill the slots before any other tier runs
+	config->set_max_results(1);
+	ordered_check(config->get_init_path(), db->get_paths_table().query("exact-check"), { "/custom_rule_check/exact_check" });
+}
+
+TEST_F(DatabaseTest, ServesShortQueriesFromTopLists) {
+	config->set_exclusion_rules({});
+	config->set_matching_type("contains");
+	config->set_max_results(2);
+	EXPECT_NO_THROW(db = make_unique<Database>(*config));
+	EXPECT_NO_THROW(db->build(config->get_init_path()));
+
+	auto listed = [&](const string& gram, int strategy) {
+		int count = 0;
+		*db << "SELECT COUNT(*) FROM top_matches WHERE gram = CAST(? AS BLOB) AND strategy = ?;" << gram << strategy >> count;
+		return count;
+	};
+	EXPECT_EQ(listed("*c", 0), 2);
+	EXPECT_EQ(listed("^c", 1), 2);
+
+	// Accesses move rows up the lists (or onto them) without a rebuild, and the lists stay max_results long
+	const string root = config->get_init_path() + "/custom_rule_check";
+	db->get_paths_table().access(root + "/suffix_check");
+	ordered_check(root, { db->get_paths_table().query("c")[0] }, { "/suffix_check" });
+	db->get_paths_table().access(root + "/exact_check");
+	ordered_check(root, db->get_paths_table().query("c"), { "/exact_check", "/suffix_check" });
+	EXPECT_EQ(listed("*c", 0), 2);
+
+	config->set_promotion_strategy("frequency_based");
+	db->get_paths_table().access(root + "/suffix_check");
+	ordered_check(root, db->get_paths_table().query("c"), { "/suffix_check", "/exact_check" });
+	config->set_matching_type("suffix");
+	ordered_check(root, db->get_paths_table().query("ck"), { "/suffix_check", "/exact_check" });
+	EXPECT_EQ(listed("*c", 1), 2);
+
+	// Empty lists only prove there are no matches when the statistics were built
+	*db << "DELETE FROM match_stats;";
+	*db << "DELETE FROM top_matches;";
+	EXPECT_EQ(db->get_paths_table().query("ck").size(), 2u);
+}
+
+TEST_F(DatabaseTest, MigrationFillsDerivedKeys) {
+	config->set_exclusion_rules({});
+	EXPECT_NO_THROW(db = make_unique<Database>(*config));
+	EXPECT_NO_THROW(db->build(config->get_init_path()));
+
+	// Rows written before the derived keys existed have the columns' defaults
+	*db << "UPDATE paths SET dir_name_folded = '', dir_name_reversed = '', dir_name_bigrams = 0;";
+	*db << "PRAGMA user_version = 2;";
+	db.reset();
+
+	config->set_matching_type("suffix");
+	EXPECT_NO_THROW(db = make_unique<Database>(*config, true));
+	unordered_check(config->get_init_path(), db->get_paths_table().query("fix_check"), {
+		"/custom_rule_check/prefix_check",
+		"/custom_rule_check/suffix_check"
+	});
+	config->set_matching_type("prefix");
+	unordered_check(config->get_init_path(), db->get_paths_table().query("Suffix"), { "/custom_rule_check/suffix_check" });
+	// Too short for the trigram index, so the bigram signatures have to be there
+	config->set_matching_type("contains");
+	unordered_check(config->get_init_path(), db->get_paths_table().query("tc"), {
+		"/custom_rule_check/exact_check",
+		"/custom_rule_check/.dot_check"
+	});
+}
+
+TEST_F(DatabaseTest, FuzzyMatchesSubsequence) {
+	config->set_exclusion_rules({});
+	config->set_matching_type("fuzzy");
+	EXPECT_NO_THROW(db = make_unique<Database>(*config));
+	EXPECT_NO_THROW(db->build(config->get_init_path()));
+
+	unordered_check(config->get_init_path(), db->get_paths_table().query("PRck"), { "/custom_rule_check/prefix_check" });
+	// The word-boundary match ranks above the one inside "contains"
+	auto results = db->get_paths_table().query("ch");
+	ASSERT_FALSE(results.empty());
+	EXPECT_NE(results[0].find("_check"), string::npos);
+
+	// An access recorded on this connection reorders the next query
+	db->get_paths_table().access(config->get_init_path() + "/custom_rule_check/suffix_check");
+	config->set_promotion_strategy("frequency_based");
+	EXPECT_EQ(db->get_paths_table().query("check")[0], config->get_init_path() + "/custom_rule_check/suffix_check");
+}
+
+TEST_F(DatabaseTest, TypoFallback) {
+	config->set_exclusion_rules({});
+	EXPECT_NO_THROW(db = make_unique<Database>(*config));
+	EXPECT_NO_THROW(db->build(config->get_init_path()));
+
+	// One transposition, one deletion, and two edits once the needle is long enough
+	unordered_check(config->get_init_path(), db->get_paths_table().query("sufifx_check"), { "/custom_rule_check/suffix_check" });
+	unordered_check(config->get_init_path(), db->get_paths_table().query("exat_check"), { "/custom_rule_check/exact_check" });
+	unordered_check(config->get_init_path(), db->get_paths_table().query("Prefxi_chekc"), { "/custom_rule_check/prefix_check" });
+
+	// Real matches come first and aren't repeated, and short needles get no fallback
+	unordered_check(config->get_init_path(), db->get_paths_table().query("suffix_check"), { "/custom_rule_check/suffix_check" });
+	EXPECT_TRUE(db->get_paths_table().query("xyz").empty());
+
+	auto names = db->get_paths_table().similar_names("contians_check", 1);
+	ASSERT_EQ(names.size(), 1u);
+	EXPECT_EQ(names[0], make_pair(1, string("containscheck")));
+}
+
+TEST_F(DatabaseTest, KeywordsMatchComponentsInOrder) {
+	config->set_exclusion_rules({});
+	EXPECT_NO_THROW(db = make_unique<Database>(*config));
+	EXPECT_NO_THROW(db->build(config->get_init_path()));
+
+	auto keywords = [&](vector<string> words) {
+		vector<string> paths;
+		db->get_paths_table().for_each_keyword_match(words, [&](string_view path) { paths.emplace_back(path); });
+		return paths;
+	};
+	unordered_check(config->get_init_path(), keywords({"CUSTOM", "prefix"}), { "/custom_rule_check/prefix_check" });
+	unordered_check(config->get_init_path(), keywords({"1", "4"}), { "/1/1/1/4" });
+	EXPECT_TRUE(keywords({"prefix", "custom"}).empty());
+	// Keywords are keyed like names: separators and case (Unicode included) don't matter
+	unordered_check(config->get_init_path(), keywords({"custom-rule", "PREFIX_check"}), { "/custom_rule_check/prefix_check" });
+	db->get_paths_table().bulk_insert({ { "/srv/Über_Service", "Über_Service" }, { "/srv/Über_Service/api", "api" } });
+	EXPECT_EQ(keywords({"über", "api"}), vector<string>{ "/srv/Über_Service/api" });
+	EXPECT_EQ(keywords({"über-service", "API"}), vector<string>{ "/srv/Über_Service/api" });
+
+	// The posting lists follow a refresh that removes a directory
+	db->get_paths_table().delete_paths({ config->get_init_path() + "/1/1/1/4" });
+	EXPECT_TRUE(keywords({"1", "4"}).empty());
+	EXPECT_TRUE(db->refresh(config->get_init_path()));
+	unordered_check(config->get_init_path(), keywords({"1", "4"}), { "/1/1/1/4" });
+}
+
+// A refresh that finds the same directories leaves the derived tables, and so the query cache, valid
+TEST_F(DatabaseTest, UnchangedRefreshKeepsGeneration) {
+	EXPECT_NO_THROW(db = make_unique<Database>(*config));
+	EXPECT_NO_THROW(db->build(config->get_init_path()));
+
+	int64_t generation = db->get_paths_table().generation();
+	EXPECT_NE(generation, 0);
+	EXPECT_TRUE(db->refresh(config->get_init_path()));
+	EXPECT_EQ(db->get_paths_table().generation(), generation);
+
+	db->get_paths_table().delete_paths({ config->get_init_path() + "/1/1/1/4" });
+	generation = db->get_paths_table().generation();
+	EXPECT_TRUE(db->refresh(config->get_init_path()));
+	EXPECT_GT(db->get_paths_table().generation(), generation);
+}
+
+TEST_F(DatabaseTest, ExpandsAbbreviatedSegments) {
+	config->set_exclusion_rules({});
+	EXPECT_NO_THROW(db = make_unique<Database>(*config));
+	EXPECT_NO_THROW(db->build(config->get_init_path()));
+
+	auto expand = [&](const string& abbreviated) {
+		vector<string> paths;
+		db->get_paths_table().for_each_expansion(abbreviated, [&](string_view path) { paths.emplace_back(path); });
+		return paths;
+	};
+	const string root = config->get_init_path();
+	unordered_check(root, expand(root + "/CU/su"), { "/custom_rule_check/suffix_check" });
+	unordered_check(root, expand(root + "/cu/"), {
+		"/custom_rule_check"
+	});
+	unordered_check(root, expand(root + "/1/1/1/4"), { "/1/1/1/4" });
+	// A name spelled out in full beats a longer sibling
+	EXPECT_EQ(expand(root + "/c/.d")[0], root + "/custom_rule_check/.dot_check");
+	EXPECT_TRUE(expand(root + "/cu/zz").empty());
+	EXPECT_TRUE(expand("relative/cu").empty());
+}
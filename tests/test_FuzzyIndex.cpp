@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+
+#include <sqlite3.h>
+
+#include <algorithm>
+#include <string>
+
+#include "FuzzyIndex.h"
+
+using namespace std;
+
+// ---- score ----
+
+TEST(FuzzyScore, MatchesOrderedSubsequence) {
+	EXPECT_TRUE(FuzzyIndex::score("dvn", "dirvana").has_value());
+	EXPECT_TRUE(FuzzyIndex::score("DVN", "dirvana").has_value());
+	EXPECT_TRUE(FuzzyIndex::score("", "dirvana").has_value());
+	EXPECT_FALSE(FuzzyIndex::score("nvd", "dirvana").has_value());
+	EXPECT_FALSE(FuzzyIndex::score("dirvanaa", "dirvana").has_value());
+}
+
+TEST(FuzzyScore, PrefersBoundariesAndRuns) {
+	// Matching the start of each word beats matching inside them
+	EXPECT_GT(*FuzzyIndex::score("sc", "src_code"), *FuzzyIndex::score("sc", "mascot"));
+	EXPECT_GT(*FuzzyIndex::score("fb", "fooBar"), *FuzzyIndex::score("fb", "fobbar"));
+	// A consecutive run beats the same characters spread out
+	EXPECT_GT(*FuzzyIndex::score("abc", "abcxx"), *FuzzyIndex::score("abc", "axbxc"));
+	// The tightest window is scored, not the first one found
+	EXPECT_EQ(*FuzzyIndex::score("ab", "a_xab"), *FuzzyIndex::score("ab", "xab"));
+}
+
+TEST(FuzzyScore, CharMaskIsSubsetOfMatches) {
+	uint64_t pattern = FuzzyIndex::char_mask("Src9");
+	EXPECT_EQ(FuzzyIndex::char_mask("my_src_v9") & pattern, pattern);
+	EXPECT_NE(FuzzyIndex::char_mask("my_src_v8") & pattern, pattern);
+}
+
+// ---- top_k ----
+
+class FuzzyIndexTest : public ::testing::Test {
+protected:
+	void SetUp() override {
+		sqlite3_open(":memory:", &connection);
+		exec("CREATE TABLE paths (id INTEGER PRIMARY KEY, path TEXT NOT NULL, dir_name TEXT NOT NULL, "
+			"last_accessed INTEGER NOT NULL, access_count INTEGER NOT NULL DEFAULT 0);");
+		// Enough rows for several prefilter blocks, with a tail that isn't a multiple of the vector width
+		exec("BEGIN;");
+		for (int i = 0; i < 10007; i++)
+			insert("/dir" + to_string(i) + (i % 7 == 0 ? "_src" : "_doc"), i);
+		exec("COMMIT;");
+	}
+	void TearDown() override { sqlite3_close(connection); }
+
+	void exec(const string& sql) { ASSERT_EQ(sqlite3_exec(connection, sql.c_str(), nullptr, nullptr, nullptr), SQLITE_OK) << sql; }
+	void insert(const string& dir_name, int last_accessed) {
+		exec("INSERT INTO paths (path, dir_name, last_accessed) VALUES ('/root" + dir_name + "', '" + dir_name.substr(1) + "', " +
+			to_string(last_accessed) + ");");
+	}
+
+	sqlite3* connection = nullptr;
+	FuzzyIndex index;
+};
+
+TEST_F(FuzzyIndexTest, ReturnsBestMatchesInOrder) {
+	index.sync(connection);
+	ASSERT_EQ(index.size(), 10007u);
+
+	auto matches = index.top_k("d1src", 5, false);
+	ASSERT_EQ(matches.size(), 5u);
+	for (size_t i = 1; i < matches.size(); i++) {
+		EXPECT_GE(matches[i - 1].score, matches[i].score);
+		if (matches[i - 1].score == matches[i].score) {
+			EXPECT_GT(matches[i - 1].rank, matches[i].rank);
+		}
+	}
+
+	// Same answer as scoring every row
+	int best = INT_MIN;
+	for (int i = 0; i < 10007; i++) {
+		string name = "dir" + to_string(i) + (i % 7 == 0 ? "_src" : "_doc");
+		if (auto s = FuzzyIndex::score("d1src", name))
+			best = max(best, *s);
+	}
+	EXPECT_EQ(matches[0].score, best);
+}
+
+TEST_F(FuzzyIndexTest, ExactNameComesFirst) {
+	insert("/zz", 0);
+	insert("/zz_zz", 99999);
+	index.sync(connection);
+	auto matches = index.top_k("zz", 10, false);
+	ASSERT_EQ(matches.size(), 2u);
+	EXPECT_TRUE(matches[0].exact);
+	EXPECT_FALSE(matches[1].exact);
+}
+
+TEST_F(FuzzyIndexTest, FollowsWrites) {
+	index.sync(connection);
+	EXPECT_TRUE(index.top_k("qq", 10, false).empty());
+
+	insert("/qq", 1);
+	index.sync(connection);
+	EXPECT_EQ(index.top_k("qq", 10, false).size(), 1u);
+
+	// A single access is applied in place and ranks by frequency straight away
+	insert("/qq_b", 1);
+	index.sync(connection);
+	exec("UPDATE paths SET access_count = 5 WHERE dir_name = 'qq_b';");
+	sqlite3_int64 id = sqlite3_last_insert_rowid(connection);
+	index.touch(connection, id, 1, 5);
+	auto matches = index.top_k("qb", 10, true);
+	ASSERT_EQ(matches.size(), 1u);
+	EXPECT_EQ(matches[0].rank, 5);
+}
+
+TEST_F(FuzzyIndexTest, StopsWhenAborted) {
+	index.sync(connection);
+	EXPECT_TRUE(index.top_k("dir", 10, false, [] { return true; }).empty());
+}
@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 
 #include <filesystem>
+#include <sstream>
 
 #include "Database.h"
 #include "Handler.h"
@@ -15,6 +16,8 @@ protected:
 		ConfigArgs args;
 		args.db_path = (filesystem::temp_directory_path() / "dirvana_handler_test.db").string();
 		filesystem::remove(args.db_path);
+		filesystem::remove(args.db_path + ".results");
+		filesystem::remove(args.db_path + ".results-stats");
 		temp_config = make_unique<TempConfigFile>(args);
 		config = make_unique<Config>(temp_config->get_path());
 		db = make_unique<Database>(*config);
@@ -28,6 +31,8 @@ protected:
 		config.reset();
 		temp_config.reset();
 		filesystem::remove(db_path);
+		filesystem::remove(db_path + ".results");
+		filesystem::remove(db_path + ".results-stats");
 	}
 
 	// Runs handle_enter and returns {return_code, stdout_output}
@@ -73,6 +78,74 @@ TEST_F(HandlerTest, EnterUnknownPartial) {
 	EXPECT_EQ(output, "cd zzz_no_match\n");
 }
 
+TEST_F(HandlerTest, EnterKeywords) {
+	string mockfs = config->get_init_path();
+	auto [ret, output] = run_enter({"1", "4"}, {{"", "keywords", ""}});
+	EXPECT_EQ(ret, 0);
+	EXPECT_EQ(output, "cd " + mockfs + "/1/1/1/4\n");
+
+	// As it reads once tab completion has filled in the last keyword
+	auto [completed_ret, completed] = run_enter({"1", mockfs + "/1/1/1/4"}, {{"", "keywords", ""}});
+	EXPECT_EQ(completed, "cd " + mockfs + "/1/1/1/4\n");
+
+	auto [missing_ret, missing] = run_enter({"1", "zzz_no_match"}, {{"", "keywords", ""}});
+	EXPECT_EQ(missing_ret, 1);
+	EXPECT_EQ(missing, "");
+
+	// A command in front still gets the path appended
+	auto [command_ret, command] = run_enter({"echo", mockfs + "/1/1/1/4"});
+	EXPECT_EQ(command, "echo " + mockfs + "/1/1/1/4\n");
+}
+
+// Without -k, the words are only keywords when the last one names no directory by itself; the first word may be a
+// shell alias that isn't on $PATH
+TEST_F(HandlerTest, EnterImplicitKeywords) {
+	string mockfs = config->get_init_path();
+	config->set_exclusion_rules({});
+	db->build(mockfs, true);
+
+	vector<string> matches = db->get_paths_table().query("4");
+	ASSERT_FALSE(matches.empty());
+	auto [alias_ret, alias] = run_enter({"ll", "4"});
+	EXPECT_EQ(alias, "ll " + matches[0] + "\n");
+
+	auto [ret, output] = run_enter({"rule", "suffix"});
+	EXPECT_EQ(ret, 0);
+	EXPECT_EQ(output, "cd " + mockfs + "/custom_rule_check/suffix_check\n");
+}
+
+TEST_F(HandlerTest, EnterRegex) {
+	string mockfs = config->get_init_path();
+	config->set_exclusion_rules({});
+	db->build(mockfs, true);
+
+	auto [ret, output] = run_enter({}, {{"", "regex", "^pre.*check$"}});
+	EXPECT_EQ(ret, 0);
+	EXPECT_EQ(output, "cd " + mockfs + "/custom_rule_check/prefix_check\n");
+
+	// A '/' makes the pattern match whole paths
+	auto [path_ret, path] = run_enter({}, {{"", "regex", "rule_check/suf"}});
+	EXPECT_EQ(path, "cd " + mockfs + "/custom_rule_check/suffix_check\n");
+
+	auto [missing_ret, missing] = run_enter({}, {{"", "regex", "^nothing_like_this$"}});
+	EXPECT_EQ(missing_ret, 1);
+	EXPECT_EQ(missing, "");
+}
+
+TEST_F(HandlerTest, EnterAbbreviatedPath) {
+	string mockfs = config->get_init_path();
+	config->set_exclusion_rules({});
+	db->build(mockfs, true);
+
+	auto [ret, output] = run_enter({mockfs + "/cus/Pre"});
+	EXPECT_EQ(ret, 0);
+	EXPECT_EQ(output, "cd " + mockfs + "/custom_rule_check/prefix_check\n");
+
+	// Paths the index knows nothing about are left alone
+	auto [literal_ret, literal] = run_enter({mockfs + "/cus/zz"});
+	EXPECT_EQ(literal, "cd " + mockfs + "/cus/zz\n");
+}
+
 TEST_F(HandlerTest, EnterVersionFlag) {
 	auto [ret, output] = run_enter({}, {{"", "version", ""}});
 	EXPECT_EQ(ret, 0);
@@ -161,6 +234,96 @@ TEST_F(HandlerTest, TabCompletionPartial) {
 	EXPECT_NE(output.find(mockfs + "/1"), string::npos);
 }
 
+TEST_F(HandlerTest, TabCompletionNulDelimited) {
+	string mockfs = config->get_init_path();
+	const char* argv[] = {"dv-binary", "--tab0", "dv", "1"};
+	ostringstream out;
+	int ret = handler->handle_tab(4, const_cast<char**>(argv), out);
+	string output = out.str();
+
+	EXPECT_EQ(ret, 0);
+	EXPECT_EQ(output.find('\n'), string::npos);
+	EXPECT_NE(output.find(mockfs + "/1" + string(1, '\0')), string::npos);
+	EXPECT_EQ(output.back(), '\0');
+}
+
+TEST_F(HandlerTest, TabCompletionKeywords) {
+	string mockfs = config->get_init_path();
+	const char* argv[] = {"dv-binary", "--tab", "dv", "-k", "1", "4"};
+	ostringstream out;
+	EXPECT_EQ(handler->handle_tab(6, const_cast<char**>(argv), out), 0);
+	EXPECT_EQ(out.str(), mockfs + "/1/1/1/4\n");
+}
+
+// Repeating a completion is answered from the query cache until the index changes
+TEST_F(HandlerTest, TabCompletionCachesResults) {
+	string mockfs = config->get_init_path();
+	const char* argv[] = {"dv-binary", "--tab", "dv", "-k", "1", "4"};
+	auto tab = [&]() {
+		ostringstream out;
+		EXPECT_EQ(handler->handle_tab(6, const_cast<char**>(argv), out), 0);
+		return out.str();
+	};
+
+	string first = tab();
+	EXPECT_EQ(first, mockfs + "/1/1/1/4\n");
+	EXPECT_EQ(tab(), first);
+	QueryCache::Stats stats = db->get_query_cache().stats();
+	EXPECT_EQ(stats.entries, 1);
+	EXPECT_EQ(stats.hits, 1);
+	EXPECT_EQ(stats.misses, 1);
+
+	// Visiting a directory moves the index to a new generation, so the next completion runs the query again
+	int64_t generation = db->get_paths_table().generation();
+	db->get_paths_table().access(mockfs + "/1/1/1/4");
+	EXPECT_GT(db->get_paths_table().generation(), generation);
+	EXPECT_EQ(tab(), first);
+	EXPECT_EQ(db->get_query_cache().stats().misses, 2);
+
+	// Nothing is cached while the statistics are missing, as they are mid-rebuild
+	*db << "DELETE FROM match_stats;";
+	EXPECT_EQ(db->get_paths_table().generation(), 0);
+	EXPECT_EQ(tab(), first);
+	EXPECT_EQ(db->get_query_cache().stats().misses, 2);
+
+	auto [ret, output] = run_enter({}, {{"", "cache-stats", ""}});
+	EXPECT_EQ(ret, 0);
+	EXPECT_EQ(output, "echo \"Query cache: 1/256 entries, 1 hits, 2 misses (33% hit rate)\"\n");
+}
+
+// Abbreviated paths only read the index, so their expansions are cached like any other completion
+TEST_F(HandlerTest, TabCompletionCachesExpansions) {
+	string mockfs = config->get_init_path();
+	string partial = mockfs + "/1/1/1/4";
+	const char* argv[] = {"dv-binary", "--tab", "dv", partial.c_str()};
+	auto tab = [&]() {
+		ostringstream out;
+		EXPECT_EQ(handler->handle_tab(4, const_cast<char**>(argv), out), 0);
+		return out.str();
+	};
+
+	EXPECT_EQ(tab(), mockfs + "/1/1/1/4\n");
+	EXPECT_EQ(tab(), mockfs + "/1/1/1/4\n");
+	QueryCache::Stats stats = db->get_query_cache().stats();
+	EXPECT_EQ(stats.hits, 1);
+	EXPECT_EQ(stats.misses, 1);
+}
+
+TEST_F(HandlerTest, TabCompletionCacheCanBeBypassed) {
+	const char* argv[] = {"dv-binary", "--tab", "dv", "1"};
+	setenv("DIRVANA_NO_QUERY_CACHE", "1", 1);
+	for (int i = 0; i < 2; i++) {
+		ostringstream out;
+		EXPECT_EQ(handler->handle_tab(4, const_cast<char**>(argv), out), 0);
+		EXPECT_FALSE(out.str().empty());
+	}
+	unsetenv("DIRVANA_NO_QUERY_CACHE");
+
+	QueryCache::Stats stats = db->get_query_cache().stats();
+	EXPECT_EQ(stats.entries, 0);
+	EXPECT_EQ(stats.hits + stats.misses, 0);
+}
+
 TEST_F(HandlerTest, TabCompletionTooFewArgs) {
 	const char* argv[] = {"dv-binary", "--tab", "dv"};
 	testing::internal::CaptureStderr();
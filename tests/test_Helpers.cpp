@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 
 #include "utils/Helpers.h"
+#include "utils/Unicode.h"
 
 using namespace std;
 
@@ -19,6 +20,94 @@ TEST(GetDirName, TrailingSlash) {
 	EXPECT_EQ(get_dir_name("/a/b/"), "");
 }
 
+// ---- reversed_key / prefix_successor ----
+
+TEST(ReversedKey, FoldsAndReverses) {
+	EXPECT_EQ(reversed_key("Src_Dir"), "ridcrs");
+}
+
+TEST(ReversedKey, KeepsMultibyteCharactersIntact) {
+	// "café" reversed by character, not by byte
+	EXPECT_EQ(reversed_key("caf\xc3\xa9"), "\xc3\xa9" "fac");
+}
+
+TEST(PrefixSuccessor, IncrementsLastByte) {
+	EXPECT_EQ(prefix_successor("abc"), "abd");
+	EXPECT_EQ(prefix_successor("ab\xff"), "ac");
+	EXPECT_EQ(prefix_successor("\xff\xff"), "");
+}
+
+// ---- Unicode::match_key ----
+
+TEST(MatchKey, FoldsAndStripsSeparators) {
+	EXPECT_EQ(Unicode::match_key("My_Service"), "myservice");
+	EXPECT_EQ(Unicode::match_key("my-service"), "myservice");
+	EXPECT_EQ(Unicode::match_key("my service.d"), "myservice.d");
+}
+
+TEST(MatchKey, FoldsBeyondAscii) {
+	// "ÜBER" and "über", and the ß that full folding expands to "ss"
+	EXPECT_EQ(Unicode::match_key("\xc3\x9c" "BER"), "\xc3\xbc" "ber");
+	EXPECT_EQ(Unicode::match_key("Stra\xc3\x9f" "e"), "strasse");
+	EXPECT_EQ(Unicode::match_key("\xce\xa3\xce\x9f\xce\xa6"), "\xcf\x83\xce\xbf\xcf\x86");
+}
+
+TEST(MatchKey, ComposesDecomposedNames) {
+	// "u" + combining diaeresis (as macOS spells file names) and Hangul jamo compose like their precomposed forms
+	EXPECT_EQ(Unicode::match_key("U\xcc\x88" "ber"), "\xc3\xbc" "ber");
+	EXPECT_EQ(Unicode::match_key("\xe1\x84\x92\xe1\x85\xa1\xe1\x86\xab"), "\xed\x95\x9c");
+	// Malformed bytes are kept as they are
+	EXPECT_EQ(Unicode::match_key("a\xff" "B"), "a\xff" "b");
+}
+
+// ---- initialism ----
+
+TEST(Initialism, SplitsOnSeparatorsAndCase) {
+	EXPECT_EQ(initialism("payment-gateway-service"), "pgs");
+	EXPECT_EQ(initialism("PaymentGatewayAdapter"), "pga");
+	EXPECT_EQ(initialism("user_auth.v2"), "uav2");
+	EXPECT_EQ(initialism("HTTPServer"), "hs");
+	EXPECT_EQ(initialism("\xc3\x9c" "ber_Uns"), "\xc3\xbc" "u");
+	// A single word has nothing to abbreviate
+	EXPECT_EQ(initialism("dirvana"), "");
+	EXPECT_EQ(initialism("Code"), "");
+}
+
+// ---- bigram_signature ----
+
+TEST(BigramSignature, CoversSubstrings) {
+	auto covers = [](const string& text, const string& key) {
+		return (bigram_signature(text) & bigram_signature(key)) == bigram_signature(key);
+	};
+	EXPECT_TRUE(covers("containscheck", "ns"));
+	EXPECT_TRUE(covers("containscheck", "check"));
+	EXPECT_FALSE(covers("containscheck", "zq"));
+	// Nothing to test for keys without a pair of bytes
+	EXPECT_EQ(bigram_signature("a"), 0);
+}
+
+// ---- Postings / components_in_order ----
+
+TEST(Postings, RoundTrip) {
+	vector<int64_t> ids = {1, 2, 130, 20000, 1LL << 40};
+	vector<int64_t> decoded;
+	Postings::decode(Postings::encode(ids), decoded);
+	EXPECT_EQ(decoded, ids);
+	// Small gaps take a byte each
+	EXPECT_EQ(Postings::encode({1, 2, 3}).size(), 3u);
+}
+
+TEST(ComponentsInOrder, LastKeywordInLeaf) {
+	EXPECT_TRUE(components_in_order("/home/me/proj/src/api", {"proj", "api"}));
+	EXPECT_TRUE(components_in_order("/home/me/Proj/API", {"proj", "api"}));
+	EXPECT_FALSE(components_in_order("/home/me/api/proj", {"proj", "api"}));
+	EXPECT_FALSE(components_in_order("/home/me/proj/api/src", {"proj", "api"}));
+	// Each keyword needs a component of its own
+	EXPECT_FALSE(components_in_order("/home/projapi", {"proj", "api"}));
+	// Components compare by their match keys
+	EXPECT_TRUE(components_in_order("/srv/Über_Service/My-API", {"überservice", "myapi"}));
+}
+
 // ---- ArgParsing::process_args ----
 
 // Helper: converts a vector of string tokens into the argc/argv form process_args expects
@@ -69,6 +158,24 @@ TEST(ProcessArgs, BypassFlag) {
 	EXPECT_EQ(flags[0].value, "mydir");
 }
 
+TEST(ProcessArgs, RegexFlag) {
+	auto [ok, cmds, flags] = parse({"dv-binary", "--enter", "dv", "--regex", "^src$"});
+	EXPECT_TRUE(ok);
+	EXPECT_TRUE(cmds.empty());
+	ASSERT_EQ(flags.size(), 1u);
+	EXPECT_EQ(flags[0].flag, "regex");
+	EXPECT_EQ(flags[0].value, "^src$");
+}
+
+// Every word after -k is a keyword rather than the flag's value
+TEST(ProcessArgs, KeywordsFlag) {
+	auto [ok, cmds, flags] = parse({"dv-binary", "--enter", "dv", "-k", "proj", "api"});
+	EXPECT_TRUE(ok);
+	EXPECT_EQ(cmds, (vector<string>{"proj", "api"}));
+	ASSERT_EQ(flags.size(), 1u);
+	EXPECT_EQ(flags[0].flag, "keywords");
+}
+
 TEST(ProcessArgs, SystemCommandBypass) {
 	// "git" is a known system command — all args are passed through as-is
 	auto [ok, cmds, flags] = parse({"dv-binary", "--enter", "dv", "git", "status"});
@@ -98,3 +205,44 @@ TEST(ArgParsingFlags, GetFlagValueDefault) {
 	vector<Flag> flags = {};
 	EXPECT_EQ(ArgParsing::get_flag_value(flags, "root", "/default"), "/default");
 }
+
+// ---- StaticMap ----
+
+TEST(StaticMap, FindsEveryKey) {
+	for (const auto& [alias, name] : ArgParsing::flag_aliases)
+		EXPECT_EQ(*ArgParsing::flag_aliases.find(alias), name);
+	for (const auto& [command, unused] : ArgParsing::system_shell_commands)
+		EXPECT_TRUE(ArgParsing::system_shell_commands.contains(command));
+}
+
+TEST(StaticMap, RejectsMissingKeys) {
+	static_assert(ArgParsing::full_flag_names.contains("root"));
+	static_assert(not ArgParsing::full_flag_names.contains("roo"));
+	EXPECT_EQ(ArgParsing::flag_aliases.find("zz"), nullptr);
+	EXPECT_FALSE(ArgParsing::system_shell_commands.contains(""));
+	EXPECT_FALSE(ArgParsing::system_shell_commands.contains("gitx"));
+}
+
+TEST(ProcessArgs, InvalidFlag) {
+	testing::internal::CaptureStderr();
+	auto [ok, cmds, flags] = parse({"dv-binary", "--enter", "dv", "build", "--nope"});
+	testing::internal::GetCapturedStderr();
+	EXPECT_FALSE(ok);
+}
+
+TEST(ProcessArgs, FlagMissingValue) {
+	testing::internal::CaptureStderr();
+	auto [ok, cmds, flags] = parse({"dv-binary", "--enter", "dv", "build", "--root"});
+	testing::internal::GetCapturedStderr();
+	EXPECT_FALSE(ok);
+}
+
+TEST(ProcessArgs, MultipleFlags) {
+	auto [ok, cmds, flags] = parse({"dv-binary", "--enter", "dv", "build", "-r", "/some/path", "-f"});
+	EXPECT_TRUE(ok);
+	ASSERT_EQ(flags.size(), 2u);
+	EXPECT_EQ(flags[0].flag, "root");
+	EXPECT_EQ(flags[0].value, "/some/path");
+	EXPECT_EQ(flags[1].flag, "force");
+	EXPECT_EQ(flags[1].cmd, "build");
+}
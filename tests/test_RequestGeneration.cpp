@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <filesystem>
+
+#include "Database.h"
+#include "RequestGeneration.h"
+#include "utils/TempConfigFile.hpp"
+
+using namespace std;
+using ConfigArgs = TempConfigFile::Args;
+
+class RequestGenerationTest : public ::testing::Test {
+protected:
+	void SetUp() override {
+		runtime_dir = filesystem::temp_directory_path() / "dirvana_generation_test";
+		filesystem::create_directories(runtime_dir);
+		setenv("XDG_RUNTIME_DIR", runtime_dir.c_str(), 1);
+	}
+	void TearDown() override {
+		filesystem::remove_all(runtime_dir);
+		unsetenv("XDG_RUNTIME_DIR");
+	}
+
+	filesystem::path runtime_dir;
+};
+
+TEST_F(RequestGenerationTest, NewerRequestSupersedesOlder) {
+	RequestGeneration first("pts_1");
+	EXPECT_FALSE(first.superseded());
+
+	RequestGeneration second("pts_1");
+	EXPECT_TRUE(first.superseded());
+	EXPECT_FALSE(second.superseded());
+}
+
+TEST_F(RequestGenerationTest, TerminalsAreIndependent) {
+	RequestGeneration first("pts_1");
+	RequestGeneration other("pts_2");
+	EXPECT_FALSE(first.superseded());
+}
+
+TEST_F(RequestGenerationTest, NoTerminalNeverSuperseded) {
+	RequestGeneration first("");
+	RequestGeneration second("");
+	EXPECT_FALSE(first.superseded());
+}
+
+TEST_F(RequestGenerationTest, AbortCheckInterruptsQuery) {
+	ConfigArgs args;
+	args.db_path = (filesystem::temp_directory_path() / "dirvana_generation_test.db").string();
+	args.match_type = "regex";
+	filesystem::remove(args.db_path);
+	TempConfigFile temp_config(args);
+	Config config(temp_config.get_path());
+	Database db(config);
+
+	// Enough rows that the contains scan runs well past the progress handler interval
+	vector<tuple<string, string>> rows;
+	for (int i = 0; i < 20000; i++)
+		rows.push_back({ "/root/dir" + to_string(i), "dir" + to_string(i) });
+	db.get_paths_table().bulk_insert(rows);
+
+	RequestGeneration older("pts_1");
+	db.set_abort_check([&older] { return older.superseded(); });
+	RequestGeneration newer("pts_1");
+
+	testing::internal::CaptureStderr();
+	// No literal a match needs is a trigram long, so this checks every row
+	size_t matches = db.get_paths_table().for_each_match("z.z", [](string_view) {});
+	string errors = testing::internal::GetCapturedStderr();
+	EXPECT_EQ(matches, 0u);
+	EXPECT_TRUE(db.was_aborted());
+	EXPECT_TRUE(errors.empty());
+
+	db.set_abort_check(nullptr);
+	filesystem::remove(args.db_path);
+}
@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <sstream>
+
+#include "StdioServer.h"
+#include "utils/TempConfigFile.hpp"
+
+using namespace std;
+using ConfigArgs = TempConfigFile::Args;
+
+class StdioServerTest : public ::testing::Test {
+protected:
+	void SetUp() override {
+		ConfigArgs args;
+		args.db_path = (filesystem::temp_directory_path() / "dirvana_stdio_test.db").string();
+		filesystem::remove(args.db_path);
+		temp_config = make_unique<TempConfigFile>(args);
+		config = make_unique<Config>(temp_config->get_path());
+		db = make_unique<Database>(*config);
+		db->build(config->get_init_path());
+		handler = make_unique<Handler>(*db);
+	}
+	void TearDown() override {
+		string db_path = config->get_db_path();
+		handler.reset();
+		db.reset();
+		config.reset();
+		temp_config.reset();
+		filesystem::remove(db_path);
+	}
+
+	// Feeds `input` to a server and returns everything it wrote
+	string serve(const string& input, bool nul_delimited = false) {
+		istringstream in(input);
+		ostringstream out;
+		testing::internal::CaptureStderr();
+		StdioServer(*handler, nul_delimited).serve(in, out);
+		testing::internal::GetCapturedStderr();
+		return out.str();
+	}
+
+	unique_ptr<TempConfigFile> temp_config;
+	unique_ptr<Config> config;
+	unique_ptr<Database> db;
+	unique_ptr<Handler> handler;
+};
+
+TEST_F(StdioServerTest, AnswersSeveralRequests) {
+	string mockfs = config->get_init_path();
+	string output = serve("tab dv 1\nenter /tmp\nenter\n");
+
+	size_t first_end = output.find("\x1e" "0\n");
+	ASSERT_NE(first_end, string::npos);
+	EXPECT_NE(output.substr(0, first_end).find(mockfs + "/1\n"), string::npos);
+	EXPECT_EQ(output.substr(first_end + 3), "cd /tmp\n\x1e" "0\ncd ~\n\x1e" "0\n");
+}
+
+TEST_F(StdioServerTest, EscapedSpacesStayInOneWord) {
+	EXPECT_EQ(serve("enter ls /tmp/a\\ b\n"), "ls /tmp/a b\n\x1e" "0\n");
+}
+
+TEST_F(StdioServerTest, NulDelimitedRequests) {
+	string input = string("enter\0ls\0/tmp/a b\0\0enter\0/tmp\0\0", 31);
+	EXPECT_EQ(serve(input, true), string("ls /tmp/a b\n\x1e" "0\0cd /tmp\n\x1e" "0\0", 26));
+}
+
+TEST_F(StdioServerTest, UnknownVerbStillEndsResponse) {
+	EXPECT_EQ(serve("bogus dv 1\n\nenter /tmp\n"), "\x1e" "2\ncd /tmp\n\x1e" "0\n");
+}
+
+TEST_F(StdioServerTest, NulModeTabCandidatesAreNulSeparated) {
+	string mockfs = config->get_init_path();
+	string output = serve(string("tab\0dv\0" "1\0\0", 10), true);
+	EXPECT_EQ(output.find('\n'), string::npos);
+	EXPECT_NE(output.find(mockfs + "/1" + string(1, '\0')), string::npos);
+	EXPECT_TRUE(output.ends_with(string("\x1e" "0") + '\0'));
+}
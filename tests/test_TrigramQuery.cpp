@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "TrigramQuery.h"
+
+using namespace std;
+
+static string fts(const string& pattern, bool key_domain = false) {
+	return TrigramQuery::from_regex(pattern, key_domain).to_fts();
+}
+
+// ---- from_regex ----
+
+TEST(TrigramQuery, LiteralsAndConcatenation) {
+	EXPECT_EQ(fts("Config"), "\"config\"");
+	EXPECT_EQ(fts("^src/.*test$"), "(\"src/\" AND \"test\")");
+	EXPECT_EQ(fts("ab"), "");
+}
+
+TEST(TrigramQuery, AlternationAndClasses) {
+	EXPECT_EQ(fts("(api|web)_server"), "(\"api_server\" OR \"web_server\")");
+	// A small class is a set of alternatives, a large one any character
+	EXPECT_EQ(fts("v[12]\\.0"), "(\"v1.0\" OR \"v2.0\")");
+	EXPECT_EQ(fts("ab[a-z]cd"), "");
+	EXPECT_EQ(fts("abc[a-z]+def"), "(\"abc\" AND \"def\")");
+}
+
+TEST(TrigramQuery, RepetitionWeakensButNeverOverconstrains) {
+	EXPECT_EQ(fts("(abc)*"), "");
+	// Implied literals drop out: abcdef contains def, and xabc contains abc
+	EXPECT_EQ(fts("(abc)?def"), "\"def\"");
+	EXPECT_EQ(fts("x(abc)+y"), "(\"bcy\" AND \"xabc\")");
+	EXPECT_EQ(fts("(?=abc)d\\1"), "");
+}
+
+TEST(TrigramQuery, KeyDomain) {
+	// Separators aren't in match keys, and a letter that ends a literal may compose with a following mark
+	EXPECT_EQ(fts("my_service", true), "\"myservic\"");
+	EXPECT_EQ(fts("v1\\.2", true), "\"v1.2\"");
+}
+
+TEST(TrigramQuery, EveryMatchSatisfiesTheQuery) {
+	const vector<string> patterns = { "(api|web)_?server", "b(a|e)+t", "^src.*(test|spec)s?$", "x[0-9]{2,3}yz", "[Cc]onf(ig)?" };
+	const vector<string> texts = { "api_server", "webserver", "bat", "beaet", "src_tests", "src/spec", "x123yz", "x12yz", "Config", "conf" };
+
+	// A literal query against a text, the way the trigram index answers it (case-insensitively)
+	function<bool(const TrigramQuery&, const string&)> satisfies = [&](const TrigramQuery& query, const string& text) {
+		string lowered = text;
+		for (char& c : lowered) c = static_cast<char>(tolower(c));
+		switch (query.op) {
+			case TrigramQuery::Op::All: return true;
+			case TrigramQuery::Op::Literal: return lowered.find(query.literal) != string::npos;
+			case TrigramQuery::Op::And:
+				return all_of(query.children.begin(), query.children.end(), [&](const auto& child) { return satisfies(child, text); });
+			case TrigramQuery::Op::Or:
+				return any_of(query.children.begin(), query.children.end(), [&](const auto& child) { return satisfies(child, text); });
+		}
+		return false;
+	};
+	for (const auto& pattern : patterns) {
+		TrigramQuery query = TrigramQuery::from_regex(pattern, false);
+		regex re(pattern, regex::ECMAScript | regex::icase);
+		for (const auto& text : texts) {
+			if (regex_search(text, re)) {
+				EXPECT_TRUE(satisfies(query, text)) << pattern << " on " << text;
+			}
+		}
+	}
+}
+
+// ---- to_sql ----
+
+TEST(TrigramQuery, ToSql) {
+	vector<string> binds;
+	EXPECT_EQ(TrigramQuery::from_regex("(foo|bar)baz", false).to_sql("path", binds),
+		"(instr(lower(path), ?) > 0 OR instr(lower(path), ?) > 0)");
+	EXPECT_EQ(binds, vector<string>({ "barbaz", "foobaz" }));
+	EXPECT_EQ(TrigramQuery::all().to_sql("path", binds), "");
+}
@@ -54,7 +54,8 @@ struct TempConfigFile {
 	~TempConfigFile() {
 		if (std::filesystem::exists(path))
 			std::filesystem::remove(path);
-	}; // Delete the temporary file when the object is destroyed
+		std::filesystem::remove(path + ".cache");
+	}; // Delete the temporary file (and its compiled snapshot) when the object is destroyed
 
 	// Save the config to a temporary file
 	void save_to_file(const json& config) const {